@@ -0,0 +1,139 @@
+#include "allocs.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#ifdef __GLIBC__
+#include <execinfo.h>
+#include <unistd.h>
+#define ALLOCS_STACKS
+#endif
+
+static std::atomic<uint64_t> total_count{0};
+static std::atomic<uint64_t> total_bytes{0};
+static std::atomic<uint64_t> total_frees{0};
+// Plain thread_local PODs, so touching them never allocates.
+static thread_local AllocCount mine;
+static thread_local bool tracing = false;
+
+AllocCount thread_allocations() { return mine; }
+
+AllocCount total_allocations() {
+  return AllocCount{total_count.load(std::memory_order_relaxed),
+                    total_bytes.load(std::memory_order_relaxed),
+                    total_frees.load(std::memory_order_relaxed)};
+}
+
+void trace_allocations(bool on) { tracing = on; }
+
+static void counted(size_t size) {
+  mine.count += 1;
+  mine.bytes += size;
+  total_count.fetch_add(1, std::memory_order_relaxed);
+  total_bytes.fetch_add(size, std::memory_order_relaxed);
+#ifdef ALLOCS_STACKS
+  if (tracing) {
+    // backtrace() may allocate itself the first time around.
+    tracing = false;
+    void *frames[32];
+    auto n = backtrace(frames, 32);
+    char line[64];
+    auto len = std::snprintf(line, sizeof(line), "allocation of %zu bytes:\n",
+                             size);
+    write(STDERR_FILENO, line, len);
+    backtrace_symbols_fd(frames, n, STDERR_FILENO);
+    tracing = true;
+  }
+#endif
+}
+
+static void freed(void *p) {
+  if (p) {
+    mine.frees += 1;
+    total_frees.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+static void release(void *p) {
+  freed(p);
+  std::free(p);
+}
+
+static void *allocate(size_t size) {
+  counted(size);
+  if (auto p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+static void *allocate(size_t size, std::align_val_t align) {
+  counted(size);
+  auto a = std::max(size_t(align), sizeof(void *));
+#ifdef _WIN32
+  auto p = _aligned_malloc(size ? size : 1, a);
+#else
+  // aligned_alloc wants the size to be a multiple of the alignment.
+  auto p = std::aligned_alloc(a, std::max<size_t>(1, (size + a - 1) / a) * a);
+#endif
+  if (p) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+static void release_aligned(void *p) {
+  freed(p);
+#ifdef _WIN32
+  _aligned_free(p);
+#else
+  std::free(p);
+#endif
+}
+
+void *operator new(size_t size) { return allocate(size); }
+void *operator new[](size_t size) { return allocate(size); }
+void *operator new(size_t size, std::align_val_t align) {
+  return allocate(size, align);
+}
+void *operator new[](size_t size, std::align_val_t align) {
+  return allocate(size, align);
+}
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  counted(size);
+  return std::malloc(size ? size : 1);
+}
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+  counted(size);
+  return std::malloc(size ? size : 1);
+}
+
+void operator delete(void *p) noexcept { release(p); }
+void operator delete[](void *p) noexcept { release(p); }
+void operator delete(void *p, size_t) noexcept { release(p); }
+void operator delete[](void *p, size_t) noexcept { release(p); }
+void operator delete(void *p, std::align_val_t) noexcept {
+  release_aligned(p);
+}
+void operator delete[](void *p, std::align_val_t) noexcept {
+  release_aligned(p);
+}
+void operator delete(void *p, size_t, std::align_val_t) noexcept {
+  release_aligned(p);
+}
+void operator delete[](void *p, size_t, std::align_val_t) noexcept {
+  release_aligned(p);
+}
+void operator delete(void *p, const std::nothrow_t &) noexcept {
+  release(p);
+}
+void operator delete[](void *p, const std::nothrow_t &) noexcept {
+  release(p);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+// Counts the heap allocations and frees made through operator new and
+// delete, which this module replaces for the whole program, per thread and
+// in total. Memory taken with malloc directly, as raylib and the C library
+// do, is not seen.
+//
+// The frame loop should not allocate once it has warmed up: every buffer it
+// fills is sized for the pools' capacity before the first frame. Sampling
+// the counts of the calling thread around a frame shows what it allocated.
+struct AllocCount {
+  uint64_t count = 0;
+  uint64_t bytes = 0;
+  uint64_t frees = 0;
+
+  AllocCount operator-(const AllocCount &o) const {
+    return AllocCount{count - o.count, bytes - o.bytes, frees - o.frees};
+  }
+  AllocCount &operator+=(const AllocCount &o) {
+    count += o.count;
+    bytes += o.bytes;
+    frees += o.frees;
+    return *this;
+  }
+};
+
+// Allocations of the calling thread since it started.
+AllocCount thread_allocations();
+// Allocations of all threads since the program started.
+AllocCount total_allocations();
+
+// While on, every allocation of the calling thread also writes its call
+// stack to stderr. Stacks come from glibc's backtrace(); elsewhere this
+// does nothing.
+void trace_allocations(bool on);
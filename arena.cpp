@@ -0,0 +1,75 @@
+#include "arena.h"
+
+#include <cstdlib>
+#include <new>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#define ARENA_MMAP
+#endif
+
+constexpr size_t HUGE_PAGE = size_t(2) << 20;
+
+Arena::Arena(size_t reserve) {
+  size = (reserve + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+#if defined(ARENA_MMAP)
+  // Map one huge page more than asked and trim, so the start is aligned.
+  auto raw = mmap(nullptr, size + HUGE_PAGE, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (raw == MAP_FAILED) {
+    throw std::bad_alloc();
+  }
+  auto addr = reinterpret_cast<uintptr_t>(raw);
+  auto aligned = (addr + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+  if (aligned > addr) {
+    munmap(raw, aligned - addr);
+  }
+  munmap(reinterpret_cast<void *>(aligned + size),
+         addr + HUGE_PAGE - aligned);
+  base = reinterpret_cast<uint8_t *>(aligned);
+#if defined(MADV_HUGEPAGE)
+  madvise(base, size, MADV_HUGEPAGE);
+#endif
+#else
+  block = std::calloc(size + 64, 1);
+  if (!block) {
+    throw std::bad_alloc();
+  }
+  base = reinterpret_cast<uint8_t *>(
+      (reinterpret_cast<uintptr_t>(block) + 63) / 64 * 64);
+#endif
+}
+
+Arena::~Arena() {
+#if defined(ARENA_MMAP)
+  munmap(base, size);
+#else
+  std::free(block);
+#endif
+}
+
+bool Arena::map(FILE *file, uint64_t at, size_t bytes) {
+  if (bytes > size) {
+    return false;
+  }
+#if defined(ARENA_MMAP)
+  if (bytes == 0) {
+    return true;
+  }
+  auto mapped = mmap(base, bytes, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_FIXED, fileno(file), off_t(at));
+  return mapped != MAP_FAILED;
+#else
+  return fseek(file, long(at), SEEK_SET) == 0 &&
+         fread(base, 1, bytes, file) == bytes;
+#endif
+}
+
+void *Arena::allocate(size_t bytes, size_t align) {
+  auto start = (offset + align - 1) / align * align;
+  if (start + bytes > size) {
+    throw std::bad_alloc();
+  }
+  offset = start + bytes;
+  return base + start;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+// Bump allocator over one block of address space reserved up front. The OS
+// only backs the pages that are actually touched, so columns sized for the
+// biggest run cost nothing until entities fill them, and they never move.
+// On Linux the block is 2 MiB aligned and offered to transparent huge pages.
+// Memory comes back zeroed and is only released with the arena.
+struct Arena {
+  explicit Arena(size_t reserve);
+  ~Arena();
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  // Throws std::bad_alloc once the reservation is used up.
+  void *allocate(size_t size, size_t align);
+
+  template <typename T> T *make(size_t n) {
+    return static_cast<T *>(
+        allocate(sizeof(T) * n, std::max<size_t>(64, alignof(T))));
+  }
+
+  size_t used() const { return offset; }
+  size_t reserved() const { return size; }
+  // Start of the block. Two arenas that made the same calls in the same
+  // order lay their allocations out identically relative to it.
+  const uint8_t *data() const { return base; }
+
+  // Makes the first `bytes` of the block read as `bytes` of `file` from
+  // `at`, which must be a multiple of the page size. On Linux the file is
+  // mapped copy-on-write over the block, so nothing is read until it is
+  // touched; elsewhere it is read in. Returns false on I/O errors.
+  bool map(FILE *file, uint64_t at, size_t bytes);
+
+private:
+  void *block = nullptr;
+  uint8_t *base = nullptr;
+  size_t size = 0;
+  size_t offset = 0;
+};
@@ -0,0 +1,29 @@
+#include "atlas.h"
+
+void Atlas::load() {
+  auto image = GenImageColor(ATLAS_WIDTH, ATLAS_HEIGHT, BLANK);
+  for (int i = 0; i < SPRITE_COUNT; ++i) {
+    auto &s = ATLAS_SPRITES[i];
+    auto sprite = LoadImageFromMemory(".png", s.png, s.png_size);
+    // A sprite that does not match its slot would spill into a neighbor.
+    ready[i] = IsImageReady(sprite) && sprite.width == s.width &&
+               sprite.height == s.height;
+    if (ready[i]) {
+      auto whole = Rectangle{0, 0, float(s.width), float(s.height)};
+      ImageDraw(&image, sprite, whole, rect(Sprite(i)), WHITE);
+    }
+    UnloadImage(sprite);
+  }
+  texture = LoadTextureFromImage(image);
+  UnloadImage(image);
+  if (!IsTextureReady(texture)) {
+    texture = Texture2D{};
+  }
+}
+
+void Atlas::unload() {
+  if (texture.id != 0) {
+    UnloadTexture(texture);
+  }
+  texture = Texture2D{};
+}
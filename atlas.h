@@ -0,0 +1,31 @@
+#pragma once
+
+#include "raylib.h"
+
+#include "atlas_data.h"
+
+// Every sprite of the game in one texture. The layout and the PNG files are
+// compiled in by cmake/atlas.cmake, so nothing is read from the working
+// directory; load() decodes each sprite into its place in a single image
+// and uploads that once. Drawing any sprite then binds the same texture,
+// which lets the sprite batch put them all in one bucket.
+struct Atlas {
+  Texture2D texture{};
+
+  // Needs the window to be open.
+  void load();
+  void unload();
+
+  // Whether `sprite` decoded, callers draw a stand-in shape otherwise.
+  bool has(Sprite sprite) const { return texture.id != 0 && ready[sprite]; }
+
+  // Where `sprite` is in the texture, in pixels.
+  Rectangle rect(Sprite sprite) const {
+    auto &s = ATLAS_SPRITES[sprite];
+    return Rectangle{float(s.x), float(s.y), float(s.width),
+                     float(s.height)};
+  }
+
+private:
+  bool ready[SPRITE_COUNT] = {};
+};
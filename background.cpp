@@ -0,0 +1,102 @@
+#include "background.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+void BackgroundIndex::build(const Rectangle *rects, int n, float cell_size) {
+  auto x0 = std::numeric_limits<float>::max();
+  auto y0 = x0;
+  auto x1 = -x0;
+  auto y1 = -x0;
+  for (int i = 0; i < n; ++i) {
+    x0 = std::min(x0, rects[i].x);
+    y0 = std::min(y0, rects[i].y);
+    x1 = std::max(x1, rects[i].x + rects[i].width);
+    y1 = std::max(y1, rects[i].y + rects[i].height);
+  }
+  bounds = n ? Rectangle{x0, y0, x1 - x0, y1 - y0} : Rectangle{0, 0, 0, 0};
+  this->cell_size = cell_size;
+  cols = std::max(1, int(std::ceil(bounds.width / cell_size)));
+  rows = std::max(1, int(std::ceil(bounds.height / cell_size)));
+  cell_start.assign(cols * rows + 1, 0);
+  stamp.assign(n, 0);
+  epoch = 0;
+
+  auto range = [&](Rectangle r, int &x0, int &y0, int &x1, int &y1) {
+    x0 = cell_of(r.x, bounds.x, cell_size, cols);
+    y0 = cell_of(r.y, bounds.y, cell_size, rows);
+    x1 = cell_of(r.x + r.width, bounds.x, cell_size, cols);
+    y1 = cell_of(r.y + r.height, bounds.y, cell_size, rows);
+  };
+
+  int cx0, cy0, cx1, cy1;
+  for (int i = 0; i < n; ++i) {
+    range(rects[i], cx0, cy0, cx1, cy1);
+    for (int cy = cy0; cy <= cy1; ++cy) {
+      for (int cx = cx0; cx <= cx1; ++cx) {
+        cell_start[cy * cols + cx + 1] += 1;
+      }
+    }
+  }
+  for (size_t c = 1; c < cell_start.size(); ++c) {
+    cell_start[c] += cell_start[c - 1];
+  }
+  cell_items.resize(cell_start.back());
+  std::vector<int> cursor(cell_start.begin(), cell_start.end() - 1);
+  for (int i = 0; i < n; ++i) {
+    range(rects[i], cx0, cy0, cx1, cy1);
+    for (int cy = cy0; cy <= cy1; ++cy) {
+      for (int cx = cx0; cx <= cx1; ++cx) {
+        cell_items[cursor[cy * cols + cx]++] = i;
+      }
+    }
+  }
+}
+
+int BackgroundIndex::query(const Rectangle *rects, Rectangle view,
+                           std::vector<int> &out) {
+  if (!overlap(view, bounds)) {
+    return 0;
+  }
+  epoch += 1;
+  if (epoch == 0) {
+    std::fill(stamp.begin(), stamp.end(), 0);
+    epoch = 1;
+  }
+  auto x0 = cell_of(view.x, bounds.x, cell_size, cols);
+  auto y0 = cell_of(view.y, bounds.y, cell_size, rows);
+  auto x1 = cell_of(view.x + view.width, bounds.x, cell_size, cols);
+  auto y1 = cell_of(view.y + view.height, bounds.y, cell_size, rows);
+  auto first = out.size();
+  int candidates = 0;
+  for (int cy = y0; cy <= y1; ++cy) {
+    for (int cx = x0; cx <= x1; ++cx) {
+      auto c = cy * cols + cx;
+      for (int i = cell_start[c]; i < cell_start[c + 1]; ++i) {
+        auto idx = cell_items[i];
+        if (stamp[idx] == epoch) {
+          continue;
+        }
+        stamp[idx] = epoch;
+        candidates += 1;
+        if (overlap(rects[idx], view)) {
+          out.push_back(idx);
+        }
+      }
+    }
+  }
+  // Overlapping tiles must keep their original draw order.
+  std::sort(out.begin() + first, out.end());
+  return candidates;
+}
+
+Rectangle camera_view(Camera2D camera, int w, int h) {
+  if (camera.zoom <= 0) {
+    auto inf = std::numeric_limits<float>::max();
+    return Rectangle{-inf / 2, -inf / 2, inf, inf};
+  }
+  return Rectangle{camera.target.x - camera.offset.x / camera.zoom,
+                   camera.target.y - camera.offset.y / camera.zoom,
+                   w / camera.zoom, h / camera.zoom};
+}
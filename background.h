@@ -0,0 +1,117 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "raylib.h"
+
+inline bool overlap(Rectangle a, Rectangle b) {
+  return a.x < b.x + b.width && b.x < a.x + a.width && a.y < b.y + b.height &&
+         b.y < a.y + a.height;
+}
+
+// Column or row of a grid of `n` cells from `origin` that holds `v`, clamped
+// to the grid.
+inline int cell_of(float v, float origin, float cell_size, int n) {
+  return int(std::clamp((v - origin) / cell_size, 0.0f, float(n - 1)));
+}
+
+// Static uniform grid over the background tiles. Built once, then queried
+// with the camera's view rectangle every frame so only the tiles on screen
+// get submitted.
+struct BackgroundIndex {
+  Rectangle bounds{0, 0, 0, 0};
+  float cell_size = 1000;
+  int cols = 0;
+  int rows = 0;
+  std::vector<int> cell_start;
+  std::vector<int> cell_items;
+  // Tiles span several cells, stamps make sure each is reported once.
+  std::vector<uint32_t> stamp;
+  uint32_t epoch = 0;
+
+  void build(const Rectangle *rects, int n, float cell_size);
+
+  // Appends to `out` the tiles overlapping `view`, in index order, and
+  // returns how many candidates the grid had to test.
+  int query(const Rectangle *rects, Rectangle view, std::vector<int> &out);
+};
+
+// World-space rectangle seen through `camera` on a `w` x `h` screen.
+Rectangle camera_view(Camera2D camera, int w, int h);
+
+// The background baked into square chunk textures of CHUNK_PX texels. Level
+// l chunks cover 2^l world units per texel; the top level has one chunk for
+// the whole field, which stays resident and stands in for any chunk that has
+// not been baked yet. The camera's zoom picks the finest level that still
+// has no more than one texel per screen pixel, so a view never needs more
+// than a handful of chunks however far out it zooms. Zoomed in past 1, even
+// level 0 would be magnified, so the tiles are drawn directly instead.
+//
+// Chunks of the other levels live in SLOTS render textures reused least
+// recently used first, and at most BAKES_PER_FRAME are baked per frame.
+struct BackgroundCache {
+  static constexpr int CHUNK_PX = 512;
+  static constexpr int MAX_LEVELS = 16;
+  static constexpr int SLOTS = 48;
+  static constexpr int BAKES_PER_FRAME = 4;
+
+  // Keeps `rects` and `colors`, which must outlive the cache, and bakes the
+  // top level. `border` is the square outlined in yellow. Needs the window
+  // to be open.
+  void load(const Rectangle *rects, const Color *colors, int n,
+            Rectangle border);
+
+  // Bakes missing chunks of the current view. Call before BeginDrawing,
+  // switching render targets mid-frame flushes the batch.
+  void prepare(Camera2D camera, int w, int h);
+  // Draws the background, between BeginMode2D(camera) and EndMode2D().
+  void draw(Camera2D camera, int w, int h);
+
+  // Levels above the one the zoom picks, for a cheaper background when
+  // frames run long.
+  int coarser = 0;
+
+  // Of the last frame, `level` is -1 when the tiles were drawn directly.
+  // Only then are tiles tested against the view and submitted.
+  int level = 0;
+  int drawn = 0;
+  int baked = 0;
+  int tiles_tested = 0;
+  int tiles_submitted = 0;
+
+private:
+  struct Slot {
+    int level = -1;
+    int cx = 0;
+    int cy = 0;
+    uint64_t used = 0;
+    RenderTexture2D target{};
+  };
+
+  // Level for `camera` and the range of its chunks the view overlaps, or
+  // level -1 and no range when the tiles are to be drawn directly. Returns
+  // false if nothing of the field is visible.
+  bool visible(Camera2D camera, int w, int h, int &lvl, int &x0, int &y0,
+               int &x1, int &y1) const;
+  float chunk_size(int lvl) const { return float(CHUNK_PX) * (1 << lvl); }
+  Slot *find(int lvl, int cx, int cy);
+  void bake(RenderTexture2D target, int lvl, int cx, int cy);
+  // Draws the tiles and the border that overlap `area`, with the border
+  // `thick` world units wide. Returns how many tiles the index tested;
+  // those drawn are left in `scratch`.
+  int draw_area(Rectangle area, float thick);
+
+  const Rectangle *rects = nullptr;
+  const Color *colors = nullptr;
+  Rectangle border{0, 0, 0, 0};
+  // Everything that has to be drawn: the tiles and the border.
+  Rectangle bounds{0, 0, 0, 0};
+  int top = 0;
+  BackgroundIndex index;
+  std::vector<int> scratch;
+  RenderTexture2D overview{};
+  Slot slots[SLOTS];
+  uint64_t frame = 0;
+};
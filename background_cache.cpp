@@ -0,0 +1,171 @@
+#include "background.h"
+
+#include <algorithm>
+#include <cmath>
+
+void BackgroundCache::load(const Rectangle *rects, const Color *colors, int n,
+                           Rectangle border) {
+  this->rects = rects;
+  this->colors = colors;
+  this->border = border;
+  index.build(rects, n, 1000);
+  scratch.reserve(n);
+  auto x0 = border.x - 3;
+  auto y0 = border.y - 3;
+  auto x1 = border.x + border.width + 3;
+  auto y1 = border.y + border.height + 3;
+  if (n) {
+    x0 = std::min(x0, index.bounds.x);
+    y0 = std::min(y0, index.bounds.y);
+    x1 = std::max(x1, index.bounds.x + index.bounds.width);
+    y1 = std::max(y1, index.bounds.y + index.bounds.height);
+  }
+  bounds = Rectangle{x0, y0, x1 - x0, y1 - y0};
+  top = 0;
+  while (top + 1 < MAX_LEVELS &&
+         chunk_size(top) < std::max(bounds.width, bounds.height)) {
+    top += 1;
+  }
+  overview = LoadRenderTexture(CHUNK_PX, CHUNK_PX);
+  bake(overview, top, 0, 0);
+  for (auto &slot : slots) {
+    slot.target = LoadRenderTexture(CHUNK_PX, CHUNK_PX);
+  }
+}
+
+bool BackgroundCache::visible(Camera2D camera, int w, int h, int &lvl,
+                              int &x0, int &y0, int &x1, int &y1) const {
+  if (camera.zoom <= 0) {
+    return false;
+  }
+  lvl = std::min(int(std::floor(std::log2(1 / camera.zoom))) + coarser, top);
+  auto view = camera_view(camera, w, h);
+  if (!overlap(view, bounds)) {
+    return false;
+  }
+  if (lvl < 0) {
+    lvl = -1;
+    return true;
+  }
+  auto size = chunk_size(lvl);
+  auto n = int(std::ceil(chunk_size(top) / size));
+  x0 = cell_of(view.x, bounds.x, size, n);
+  y0 = cell_of(view.y, bounds.y, size, n);
+  x1 = cell_of(view.x + view.width, bounds.x, size, n);
+  y1 = cell_of(view.y + view.height, bounds.y, size, n);
+  return true;
+}
+
+BackgroundCache::Slot *BackgroundCache::find(int lvl, int cx, int cy) {
+  for (auto &slot : slots) {
+    if (slot.level == lvl && slot.cx == cx && slot.cy == cy) {
+      return &slot;
+    }
+  }
+  return nullptr;
+}
+
+void BackgroundCache::bake(RenderTexture2D target, int lvl, int cx, int cy) {
+  auto size = chunk_size(lvl);
+  auto area = Rectangle{bounds.x + cx * size, bounds.y + cy * size, size,
+                        size};
+  Camera2D camera{};
+  camera.target = Vector2{area.x, area.y};
+  camera.zoom = 1.0f / (1 << lvl);
+  BeginTextureMode(target);
+  ClearBackground(LIME);
+  BeginMode2D(camera);
+  // Keep the border at least a texel wide when zoomed out.
+  draw_area(area, std::max(5.0f, float(1 << lvl)));
+  EndMode2D();
+  EndTextureMode();
+}
+
+int BackgroundCache::draw_area(Rectangle area, float thick) {
+  scratch.clear();
+  auto tested = index.query(rects, area, scratch);
+  for (auto i : scratch) {
+    DrawRectangleRec(rects[i], colors[i]);
+  }
+  auto l = border.x;
+  auto t = border.y;
+  auto r = border.x + border.width;
+  auto b = border.y + border.height;
+  DrawLineEx({l, t}, {l, b}, thick, YELLOW);
+  DrawLineEx({r, t}, {r, b}, thick, YELLOW);
+  DrawLineEx({l, t}, {r, t}, thick, YELLOW);
+  DrawLineEx({r, b}, {l, b}, thick, YELLOW);
+  return tested;
+}
+
+void BackgroundCache::prepare(Camera2D camera, int w, int h) {
+  frame += 1;
+  baked = 0;
+  int x0, y0, x1, y1;
+  if (!visible(camera, w, h, level, x0, y0, x1, y1) || level < 0 ||
+      level == top) {
+    return;
+  }
+  for (int cy = y0; cy <= y1; ++cy) {
+    for (int cx = x0; cx <= x1; ++cx) {
+      if (auto slot = find(level, cx, cy)) {
+        slot->used = frame;
+        continue;
+      }
+      if (baked == BAKES_PER_FRAME) {
+        continue;
+      }
+      // Least recently used, never one this frame still needs.
+      Slot *victim = nullptr;
+      for (auto &slot : slots) {
+        if (slot.used < frame && (!victim || slot.used < victim->used)) {
+          victim = &slot;
+        }
+      }
+      if (!victim) {
+        return;
+      }
+      bake(victim->target, level, cx, cy);
+      *victim = Slot{level, cx, cy, frame, victim->target};
+      baked += 1;
+    }
+  }
+}
+
+void BackgroundCache::draw(Camera2D camera, int w, int h) {
+  drawn = 0;
+  tiles_tested = 0;
+  tiles_submitted = 0;
+  int lvl, x0, y0, x1, y1;
+  if (!visible(camera, w, h, lvl, x0, y0, x1, y1)) {
+    return;
+  }
+  if (lvl < 0) {
+    tiles_tested = draw_area(camera_view(camera, w, h), 5);
+    tiles_submitted = int(scratch.size());
+    return;
+  }
+  auto size = chunk_size(lvl);
+  // Texels of the overview per chunk of this level.
+  auto part = float(CHUNK_PX >> (top - lvl));
+  for (int cy = y0; cy <= y1; ++cy) {
+    for (int cx = x0; cx <= x1; ++cx) {
+      auto dest = Rectangle{bounds.x + cx * size, bounds.y + cy * size, size,
+                            size};
+      // Render textures are stored bottom row first, hence the negative
+      // heights and the flipped source rows of the overview.
+      auto slot = lvl == top ? nullptr : find(lvl, cx, cy);
+      if (slot) {
+        DrawTexturePro(slot->target.texture,
+                       Rectangle{0, 0, float(CHUNK_PX), -float(CHUNK_PX)},
+                       dest, Vector2{0, 0}, 0, WHITE);
+      } else {
+        DrawTexturePro(overview.texture,
+                       Rectangle{cx * part, CHUNK_PX - (cy + 1) * part, part,
+                                 -part},
+                       dest, Vector2{0, 0}, 0, WHITE);
+      }
+      drawn += 1;
+    }
+  }
+}
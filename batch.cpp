@@ -0,0 +1,96 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <cmath>
+
+constexpr int MAX_SIDES = 64;
+
+// {cos, sin} of the angle between two neighbouring polygon vertices.
+struct RotationSteps {
+  Vector2 step[MAX_SIDES + 1] = {};
+
+  RotationSteps() {
+    for (int sides = 3; sides <= MAX_SIDES; ++sides) {
+      auto a = 2 * PI / sides;
+      step[sides] = Vector2{std::cos(a), std::sin(a)};
+    }
+  }
+};
+
+static const RotationSteps rotation_steps;
+
+SpriteBatch::Bucket &SpriteBatch::bucket(unsigned texture, bool quads) {
+  for (auto &b : buckets) {
+    if (b.texture == texture && b.quads == quads) {
+      return b;
+    }
+  }
+  buckets.push_back(Bucket{texture, quads, {}});
+  return buckets.back();
+}
+
+void SpriteBatch::reserve(unsigned texture, bool quads, int vertices) {
+  bucket(texture, quads).verts.reserve(vertices);
+}
+
+void SpriteBatch::sprite(Texture2D texture, Rectangle src, Rectangle dst,
+                         Color tint) {
+  auto &verts = bucket(texture.id, true).verts;
+  auto x1 = dst.x + dst.width;
+  auto y1 = dst.y + dst.height;
+  auto su = 1.0f / std::max(1, texture.width);
+  auto sv = 1.0f / std::max(1, texture.height);
+  auto u0 = src.x * su;
+  auto v0 = src.y * sv;
+  auto u1 = (src.x + src.width) * su;
+  auto v1 = (src.y + src.height) * sv;
+  verts.push_back(BatchVertex{dst.x, dst.y, u0, v0, tint});
+  verts.push_back(BatchVertex{dst.x, y1, u0, v1, tint});
+  verts.push_back(BatchVertex{x1, y1, u1, v1, tint});
+  verts.push_back(BatchVertex{x1, dst.y, u1, v0, tint});
+}
+
+void SpriteBatch::poly(Vector2 center, int sides, float radius,
+                       Vector2 facing, Color color) {
+  sides = std::clamp(sides, 3, MAX_SIDES);
+  auto step = rotation_steps.step[sides];
+  auto &verts = bucket(0, false).verts;
+  auto cx = facing.x * radius;
+  auto cy = facing.y * radius;
+  for (int i = 0; i < sides; ++i) {
+    auto nx = cx * step.x - cy * step.y;
+    auto ny = cx * step.y + cy * step.x;
+    // Same winding as DrawPoly: center, next, current.
+    verts.push_back(BatchVertex{center.x, center.y, 0, 0, color});
+    verts.push_back(BatchVertex{center.x + nx, center.y + ny, 0, 0, color});
+    verts.push_back(BatchVertex{center.x + cx, center.y + cy, 0, 0, color});
+    cx = nx;
+    cy = ny;
+  }
+}
+
+void SpriteBatch::square(Vector2 center, float half, Color color) {
+  auto &verts = bucket(0, false).verts;
+  auto x0 = center.x - half;
+  auto y0 = center.y - half;
+  auto x1 = center.x + half;
+  auto y1 = center.y + half;
+  // Same winding as DrawRectangle.
+  verts.push_back(BatchVertex{x0, y0, 0, 0, color});
+  verts.push_back(BatchVertex{x0, y1, 0, 0, color});
+  verts.push_back(BatchVertex{x1, y1, 0, 0, color});
+  verts.push_back(BatchVertex{x0, y0, 0, 0, color});
+  verts.push_back(BatchVertex{x1, y1, 0, 0, color});
+  verts.push_back(BatchVertex{x1, y0, 0, 0, color});
+}
+
+void SpriteBatch::flush(BatchBackend &backend) {
+  for (auto &b : buckets) {
+    if (!b.verts.empty()) {
+      backend.submit(b.texture, b.quads, b.verts.data(), b.verts.size());
+      draw_calls += 1;
+      vertices += b.verts.size();
+      b.verts.clear();
+    }
+  }
+}
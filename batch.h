@@ -0,0 +1,91 @@
+#pragma once
+
+#include <vector>
+
+#include "raylib.h"
+
+struct BatchVertex {
+  float x, y;
+  float u, v;
+  Color color;
+};
+
+// Receives one flushed bucket: every vertex drawn with the same texture and
+// primitive mode. `texture` 0 means untextured shapes.
+struct BatchBackend {
+  virtual ~BatchBackend() = default;
+  virtual void submit(unsigned texture, bool quads, const BatchVertex *verts,
+                      int count) = 0;
+};
+
+// Tallies submissions without drawing, for headless runs.
+struct CountingBackend : BatchBackend {
+  int draw_calls = 0;
+  int vertices = 0;
+
+  void reset() {
+    draw_calls = 0;
+    vertices = 0;
+  }
+  void submit(unsigned, bool, const BatchVertex *, int count) override {
+    draw_calls += 1;
+    vertices += count;
+  }
+};
+
+// Sends buckets through rlgl. Only built into the windowed game.
+struct RlglBackend : BatchBackend {
+  void submit(unsigned texture, bool quads, const BatchVertex *verts,
+              int count) override;
+};
+
+// Collects sprites and filled polygons into one vertex array per texture and
+// primitive mode, and hands each array to the backend in a single submission
+// on flush(). Buckets are flushed in the order they were first used, so call
+// flush() between layers that must not interleave.
+struct SpriteBatch {
+  static constexpr int CIRCLE_SIDES = 36;
+
+  struct Bucket {
+    unsigned texture;
+    bool quads;
+    std::vector<BatchVertex> verts;
+  };
+  std::vector<Bucket> buckets;
+  int draw_calls = 0;
+  int vertices = 0;
+
+  void sprite(Texture2D texture, Rectangle dst, Color tint) {
+    sprite(texture,
+           Rectangle{0, 0, float(texture.width), float(texture.height)}, dst,
+           tint);
+  }
+  // The `src` rectangle of `texture`, in pixels, drawn over `dst`.
+  void sprite(Texture2D texture, Rectangle src, Rectangle dst, Color tint);
+  // Same shape as DrawPoly, with the rotation given as the unit vector
+  // {cos, sin} of the angle instead of the angle itself. The vertices are
+  // then rotated incrementally, so no trigonometry runs per shape.
+  void poly(Vector2 center, int sides, float radius, Vector2 facing,
+            Color color);
+  void poly(Vector2 center, int sides, float radius, Color color) {
+    poly(center, sides, radius, Vector2{1, 0}, color);
+  }
+  void circle(Vector2 center, float radius, Color color) {
+    poly(center, CIRCLE_SIDES, radius, color);
+  }
+  // Axis-aligned square of side 2 * `half`, two triangles.
+  void square(Vector2 center, float half, Color color);
+
+  // Makes room for `vertices` in the bucket of `texture` and `quads`, so
+  // frames that queue no more than that never allocate.
+  void reserve(unsigned texture, bool quads, int vertices);
+  void flush(BatchBackend &backend);
+  // Clears the per-frame draw call and vertex totals.
+  void reset_stats() {
+    draw_calls = 0;
+    vertices = 0;
+  }
+
+private:
+  Bucket &bucket(unsigned texture, bool quads);
+};
@@ -0,0 +1,27 @@
+#include <algorithm>
+
+#include "rlgl.h"
+
+#include "batch.h"
+
+// Multiple of both 3 and 4 and well below rlgl's default batch size, so a
+// chunk never ends mid-primitive and rlgl never splits one on its own.
+constexpr int CHUNK = 4092;
+
+void RlglBackend::submit(unsigned texture, bool quads, const BatchVertex *verts,
+                         int count) {
+  rlSetTexture(texture);
+  for (int first = 0; first < count; first += CHUNK) {
+    auto n = std::min(CHUNK, count - first);
+    rlCheckRenderBatchLimit(n);
+    rlBegin(quads ? RL_QUADS : RL_TRIANGLES);
+    for (int i = first; i < first + n; ++i) {
+      auto &v = verts[i];
+      rlColor4ub(v.color.r, v.color.g, v.color.b, v.color.a);
+      rlTexCoord2f(v.u, v.v);
+      rlVertex2f(v.x, v.y);
+    }
+    rlEnd();
+  }
+  rlSetTexture(0);
+}
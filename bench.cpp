@@ -0,0 +1,394 @@
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+#include <fmt/format.h>
+
+#include "allocs.h"
+#include "batch.h"
+#include "checkpoint.h"
+#include "governor.h"
+#include "jobs.h"
+#include "profiler.h"
+#include "render.h"
+#include "replay.h"
+#include "snapshot.h"
+#include "world.h"
+
+// Frame time and live entities of the frames a stress run spent while the
+// live entity count was in [2^k, 2^(k+1)).
+struct Bracket {
+  uint64_t frames = 0;
+  uint64_t enemies = 0;
+  uint64_t bullets = 0;
+  double ns = 0;
+  PhaseTimes times;
+};
+
+static void print_brackets(const std::vector<Bracket> &brackets) {
+  fmt::print("{:>9}{:>7}{:>10}{:>10}{:>12}", "live", "frames", "enemies",
+             "bullets", "us/frame");
+  for (int p = 0; p < PHASE_COUNT; ++p) {
+    fmt::print("{:>9}", PHASE_NAMES[p]);
+  }
+  fmt::print("\n");
+  for (size_t k = 0; k < brackets.size(); ++k) {
+    auto &b = brackets[k];
+    if (!b.frames) {
+      continue;
+    }
+    auto n = double(b.frames);
+    fmt::print("{:>9}{:>7}{:>10.0f}{:>10.0f}{:>12.1f}", uint64_t(1) << k,
+               b.frames, b.enemies / n, b.bullets / n, b.ns / n / 1e3);
+    for (int p = 0; p < PHASE_COUNT; ++p) {
+      fmt::print("{:>9.1f}", b.times.ns[p] / n / 1e3);
+    }
+    fmt::print("\n");
+  }
+}
+
+// Fills `world` up to its capacity, a growing batch of enemies and bullets
+// per frame, and times every frame.
+static std::vector<Bracket> stress(World &world, uint64_t frames,
+                                   uint64_t seed) {
+  std::vector<Bracket> brackets(64);
+  PhaseTimes times;
+  world.timing = &times;
+  Rng rng;
+  rng.seed(seed ^ 0x9e3779b97f4a7c15ull);
+  auto scatter = [&](float radius) {
+    auto angle = rng.value(0, 6283) / 1000.0f;
+    auto r = radius * std::sqrt(rng.value(0, 1000) / 1000.0f);
+    return Vector2{world.player.x + r * std::cos(angle),
+                   world.player.y + r * std::sin(angle)};
+  };
+  for (uint64_t frame = 0; frame < frames; ++frame) {
+    world.player_hp = INT_MAX / 2;
+    world.game_over = false;
+    auto room_e = world.capacity() - world.enemies.count;
+    auto room_b = world.capacity() - world.bullets.count;
+    if (room_e == 0 && room_b == 0) {
+      break;
+    }
+    auto n_e = std::min(room_e, std::max(256, world.enemies.count / 32));
+    for (int i = 0; i < n_e; ++i) {
+      world.spawn_enemy(scatter(1000), 50);
+    }
+    auto n_b = std::min(room_b, std::max(256, world.bullets.count / 32));
+    for (int i = 0; i < n_b; ++i) {
+      world.spawn_bullet(scatter(1000),
+                         Vector2{float(rng.value(-2, 2)),
+                                 float(rng.value(-2, 2))},
+                         BULLET_STRAIGHT);
+    }
+
+    auto before = times;
+    auto start = std::chrono::steady_clock::now();
+    world.step(Input{});
+    auto end = std::chrono::steady_clock::now();
+    auto live = world.enemies.count + world.bullets.count;
+    auto &b = brackets[std::bit_width(unsigned(std::max(1, live))) - 1];
+    b.frames += 1;
+    b.enemies += world.enemies.count;
+    b.bullets += world.bullets.count;
+    b.ns += std::chrono::duration<double, std::nano>(end - start).count();
+    for (int p = 0; p < PHASE_COUNT; ++p) {
+      b.times.ns[p] += times.ns[p] - before.ns[p];
+    }
+  }
+  return brackets;
+}
+
+// Runs the simulation without a window and reports how long a tick takes.
+// Usage: VSRO_bench [--frames N] [--seed S] [--threads T] [--batch]
+//                   [--quality LEVEL]
+//                   [--record FILE | --replay FILE | --load FILE]
+//                   [--save FILE] [--checksum-every N] [--capacity N]
+//                   [--profile-csv FILE] [--profile-trace FILE] [--stress]
+//                   [--alloc-check WARMUP]
+//   --threads  run the parallel passes on T threads (default 1, inline).
+//   --batch  also snapshot every frame and queue the entities, halfway
+//            between two snapshots, through the sprite batch with a counting
+//            backend, and report draw calls and vertices.
+//   --quality  with --batch, draw the entities the way the frame governor
+//            does at this level, 0 (full detail) to 4.
+//   --record  save the seed and the scripted input to FILE.
+//   --replay  step through FILE, recorded here or by the game, instead of
+//             the scripted walk; --frames and --seed are taken from it.
+//   --checksum-every  print the world checksum every N frames.
+//   --capacity  how many entities each pool holds (default ENOUGH).
+//   --profile-csv, --profile-trace  profile every phase and write the last
+//             Profiler::CAPACITY zones as CSV or as a Chrome trace.
+//   --stress  keep the player alive and pour enemies and bullets in around
+//             them until both pools are full (capacity defaults to 1<<20),
+//             then report frame and phase times per power of two of live
+//             entities.
+//   --alloc-check  fail if a tick, or with --batch its drawing, allocates on
+//             the heap on any thread after the first WARMUP frames, and
+//             report which frames did. With glibc, the stacks of such
+//             allocations on the main thread are printed too. Ticks and
+//             drawing stop allocating after the first two frames, which
+//             size the snapshots.
+//   --load  start from a checkpoint instead of a fresh world.
+//   --save  write a checkpoint of the world after the last frame.
+int main(int argc, char *argv[]) {
+  uint64_t frames = 10000;
+  uint64_t seed = 42;
+  int threads = 1;
+  bool batched = false;
+  int quality = 0;
+  const char *record_path = nullptr;
+  const char *replay_path = nullptr;
+  int checksum_every = 0;
+  int capacity = 0;
+  bool stressed = false;
+  const char *csv_path = nullptr;
+  const char *load_path = nullptr;
+  const char *save_path = nullptr;
+  const char *trace_path = nullptr;
+  int64_t alloc_warmup = -1;
+  for (int i = 1; i < argc; ++i) {
+    if (!std::strcmp(argv[i], "--frames") && i + 1 < argc) {
+      frames = std::strtoull(argv[++i], nullptr, 10);
+    } else if (!std::strcmp(argv[i], "--seed") && i + 1 < argc) {
+      seed = std::strtoull(argv[++i], nullptr, 10);
+    } else if (!std::strcmp(argv[i], "--threads") && i + 1 < argc) {
+      threads = std::atoi(argv[++i]);
+    } else if (!std::strcmp(argv[i], "--batch")) {
+      batched = true;
+    } else if (!std::strcmp(argv[i], "--quality") && i + 1 < argc) {
+      quality = std::clamp(std::atoi(argv[++i]), 0,
+                           Governor::LEVEL_COUNT - 1);
+    } else if (!std::strcmp(argv[i], "--record") && i + 1 < argc) {
+      record_path = argv[++i];
+    } else if (!std::strcmp(argv[i], "--replay") && i + 1 < argc) {
+      replay_path = argv[++i];
+    } else if (!std::strcmp(argv[i], "--checksum-every") && i + 1 < argc) {
+      checksum_every = std::atoi(argv[++i]);
+    } else if (!std::strcmp(argv[i], "--capacity") && i + 1 < argc) {
+      capacity = std::max(1, std::atoi(argv[++i]));
+    } else if (!std::strcmp(argv[i], "--stress")) {
+      stressed = true;
+    } else if (!std::strcmp(argv[i], "--load") && i + 1 < argc) {
+      load_path = argv[++i];
+    } else if (!std::strcmp(argv[i], "--save") && i + 1 < argc) {
+      save_path = argv[++i];
+    } else if (!std::strcmp(argv[i], "--profile-csv") && i + 1 < argc) {
+      csv_path = argv[++i];
+    } else if (!std::strcmp(argv[i], "--profile-trace") && i + 1 < argc) {
+      trace_path = argv[++i];
+    } else if (!std::strcmp(argv[i], "--alloc-check") && i + 1 < argc) {
+      alloc_warmup = std::max<int64_t>(0, std::atoll(argv[++i]));
+    } else {
+      fmt::print(stderr, "unknown argument: {}\n", argv[i]);
+      return 1;
+    }
+  }
+
+  Recording recording;
+  recording.seed = seed;
+  recording.capacity = capacity ? capacity : stressed ? 1 << 20 : ENOUGH;
+  if (replay_path) {
+    if (!recording.load(replay_path)) {
+      fmt::print(stderr, "can't read recording {}\n", replay_path);
+      return 1;
+    }
+    seed = recording.seed;
+    frames = recording.ticks.size();
+  }
+
+  std::unique_ptr<World> world;
+  if (load_path) {
+    if (record_path || replay_path) {
+      fmt::print(stderr, "--load can't be combined with recordings\n");
+      return 1;
+    }
+    auto start = std::chrono::steady_clock::now();
+    world = load_checkpoint(load_path);
+    auto end = std::chrono::steady_clock::now();
+    if (!world) {
+      fmt::print(stderr, "can't read checkpoint {}\n", load_path);
+      return 1;
+    }
+    fmt::print("load:            {:.3f} ms\n",
+               std::chrono::duration<double, std::milli>(end - start).count());
+  } else {
+    world = std::make_unique<World>(seed, recording.capacity);
+    world->view_w = recording.view_w;
+    world->view_h = recording.view_h;
+  }
+  PhaseTimes phase_times;
+  world->timing = &phase_times;
+  std::vector<std::pair<uint64_t, uint64_t>> checksums;
+  std::unique_ptr<Profiler> profiler;
+  if (csv_path || trace_path) {
+    profiler = std::make_unique<Profiler>();
+    world->profiler = profiler.get();
+  }
+  std::unique_ptr<JobSystem> jobs;
+  if (threads > 1) {
+    jobs = std::make_unique<JobSystem>(threads);
+    world->jobs = jobs.get();
+  }
+  // Writes the checkpoint if asked to, false on failure.
+  auto save = [&] {
+    if (!save_path) {
+      return true;
+    }
+    auto start = std::chrono::steady_clock::now();
+    if (!save_checkpoint(*world, save_path)) {
+      fmt::print(stderr, "can't write checkpoint {}\n", save_path);
+      return false;
+    }
+    auto end = std::chrono::steady_clock::now();
+    fmt::print("save:            {:.3f} ms\n",
+               std::chrono::duration<double, std::milli>(end - start).count());
+    return true;
+  };
+  if (stressed) {
+    auto start = std::chrono::steady_clock::now();
+    auto brackets = stress(*world, frames, seed);
+    auto end = std::chrono::steady_clock::now();
+    fmt::print("capacity:        {}\n", world->capacity());
+    fmt::print("threads:         {}\n", threads);
+    fmt::print("frames:          {}\n", world->frame_counter);
+    fmt::print("total:           {:.1f} ms\n",
+               std::chrono::duration<double, std::milli>(end - start).count());
+    fmt::print("arena:           {:.1f} of {:.1f} MiB\n",
+               world->arena.used() / 1048576.0,
+               world->arena.reserved() / 1048576.0);
+    print_brackets(brackets);
+    return save() ? 0 : 1;
+  }
+  uint64_t entities = 0;
+  int restarts = 0;
+  auto snapshots = std::make_unique<Snapshot[]>(2);
+  SpriteBatch batch;
+  CountingBackend counter;
+  // A stand-in for the sprite atlas with the enemy in a 32x32 corner, only
+  // the id and sizes matter here.
+  Texture2D atlas{1, 256, 256, 1, 0};
+  Rectangle enemy_sprite{0, 0, 32, 32};
+  if (batched) {
+    reserve_entities(batch, atlas, world->capacity());
+  }
+  Governor governor(60);
+  governor.stats.level = Governor::Level(quality);
+  auto detail = governor.entity_detail();
+  uint64_t draw_calls = 0;
+  uint64_t vertices = 0;
+  // Frames past the warmup that allocated, and what they allocated.
+  uint64_t alloc_frames = 0;
+  AllocCount frame_allocs;
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t frame = 0; frame < frames; ++frame) {
+    uint8_t tick;
+    if (replay_path) {
+      tick = recording.ticks[frame];
+    } else {
+      // Walk in a square so enemies keep streaming in from all sides.
+      Input input;
+      switch ((frame / 240) % 4) {
+      case 0:
+        input.right = true;
+        break;
+      case 1:
+        input.down = true;
+        break;
+      case 2:
+        input.left = true;
+        break;
+      case 3:
+        input.up = true;
+        break;
+      }
+      tick = input.bits();
+      if (world->game_over) {
+        tick |= Recording::RESTART;
+      }
+      if (record_path) {
+        recording.ticks.push_back(tick);
+      }
+    }
+    if (tick & Recording::RESTART) {
+      restarts += 1;
+    }
+    if (alloc_warmup >= 0 && frame == uint64_t(alloc_warmup)) {
+      trace_allocations(true);
+    }
+    auto allocs_start = total_allocations();
+    replay_tick(*world, tick);
+    auto allocs = total_allocations() - allocs_start;
+    if (checksum_every > 0 && (frame + 1) % checksum_every == 0) {
+      checksums.emplace_back(frame + 1, world->checksum());
+    }
+    entities += world->live_entities();
+    if (batched) {
+      auto &prev = snapshots[(frame + 1) % 2];
+      auto &curr = snapshots[frame % 2];
+      allocs_start = total_allocations();
+      curr.capture(*world);
+      counter.reset();
+      draw_entities(prev, curr, 0.5f, atlas, enemy_sprite, detail, batch,
+                    counter);
+      draw_calls += counter.draw_calls;
+      vertices += counter.vertices;
+      allocs += total_allocations() - allocs_start;
+    }
+    if (alloc_warmup >= 0 && frame >= uint64_t(alloc_warmup) && allocs.count) {
+      if (alloc_frames < 10) {
+        fmt::print(stderr, "frame {} allocated {} times ({} bytes)\n", frame,
+                   allocs.count, allocs.bytes);
+      }
+      alloc_frames += 1;
+      frame_allocs += allocs;
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  trace_allocations(false);
+
+  auto ns = std::chrono::duration<double, std::nano>(end - start).count();
+  fmt::print("frames:          {}\n", frames);
+  fmt::print("seed:            {}\n", seed);
+  fmt::print("threads:         {}\n", threads);
+  fmt::print("restarts:        {}\n", restarts);
+  fmt::print("total:           {:.1f} ms\n", ns / 1e6);
+  fmt::print("ns/frame:        {:.0f}\n", ns / frames);
+  fmt::print("entities/frame:  {:.1f}\n", double(entities) / frames);
+  fmt::print("ns/entity:       {:.2f}\n", ns / std::max<uint64_t>(1, entities));
+  fmt::print("final level:     {}\n", world->player_level);
+  if (batched) {
+    fmt::print("draw calls/frame: {:.2f}\n", double(draw_calls) / frames);
+    fmt::print("vertices/frame:   {:.0f}\n", double(vertices) / frames);
+  }
+  fmt::print("final checksum:  {:016x}\n", world->checksum());
+  if (alloc_warmup >= 0) {
+    fmt::print("allocating frames: {} after {} warmup, {} allocations "
+               "({} bytes), {} frees\n",
+               alloc_frames, alloc_warmup, frame_allocs.count,
+               frame_allocs.bytes, frame_allocs.frees);
+  }
+  print_replay_report(checksums, phase_times);
+  if (!save()) {
+    return 1;
+  }
+  if (csv_path && !profiler->write_csv(csv_path)) {
+    fmt::print(stderr, "can't write profile {}\n", csv_path);
+    return 1;
+  }
+  if (trace_path && !profiler->write_trace(trace_path)) {
+    fmt::print(stderr, "can't write trace {}\n", trace_path);
+    return 1;
+  }
+  if (record_path && !recording.save(record_path)) {
+    fmt::print(stderr, "can't write recording {}\n", record_path);
+    return 1;
+  }
+  return alloc_frames ? 1 : 0;
+}
@@ -0,0 +1,88 @@
+#include "bots.h"
+
+#include <cmath>
+#include <cstring>
+
+const char *const BOT_NAMES[BOT_KIND_COUNT] = {"still", "circle", "kite"};
+
+// Keys for heading along `d`, one of eight directions. Components under
+// a third of the larger one are dropped.
+static Input steer(Vector2 d) {
+  auto ax = std::fabs(d.x);
+  auto ay = std::fabs(d.y);
+  auto big = std::fmax(ax, ay);
+  Input input;
+  if (big == 0) {
+    return input;
+  }
+  if (ax * 3 >= big) {
+    input.left = d.x < 0;
+    input.right = d.x > 0;
+  }
+  if (ay * 3 >= big) {
+    input.up = d.y < 0;
+    input.down = d.y > 0;
+  }
+  return input;
+}
+
+static Vector2 circle_heading(uint64_t tick) {
+  auto angle = float(tick % CIRCLE_PERIOD) / CIRCLE_PERIOD * 2 * PI;
+  return Vector2{std::cos(angle), std::sin(angle)};
+}
+
+struct StillBot : BotPolicy {
+  Input decide(const World &) override { return Input{}; }
+};
+
+struct CircleBot : BotPolicy {
+  Input decide(const World &world) override {
+    return steer(circle_heading(world.frame_counter));
+  }
+};
+
+struct KiteBot : BotPolicy {
+  Input decide(const World &world) override {
+    auto &e = world.enemies;
+    auto p = world.player;
+    auto r2 = KITE_RADIUS * KITE_RADIUS;
+    auto away = Vector2{0, 0};
+    for (int i = 0; i < e.count; ++i) {
+      auto dx = p.x - e.x[i];
+      auto dy = p.y - e.y[i];
+      auto d2 = dx * dx + dy * dy;
+      if (e.alive[i] && d2 < r2) {
+        // Unit vector away from the enemy over its distance.
+        auto w = 1 / std::fmax(d2, 1.0f);
+        away.x += dx * w;
+        away.y += dy * w;
+      }
+    }
+    if (away.x == 0 && away.y == 0) {
+      return steer(circle_heading(world.frame_counter));
+    }
+    return steer(away);
+  }
+};
+
+std::unique_ptr<BotPolicy> make_bot(BotKind kind) {
+  switch (kind) {
+  case BOT_STILL:
+    return std::make_unique<StillBot>();
+  case BOT_CIRCLE:
+    return std::make_unique<CircleBot>();
+  case BOT_KITE:
+    return std::make_unique<KiteBot>();
+  default:
+    return nullptr;
+  }
+}
+
+BotKind bot_kind(const char *name) {
+  for (int k = 0; k < BOT_KIND_COUNT; ++k) {
+    if (!std::strcmp(name, BOT_NAMES[k])) {
+      return BotKind(k);
+    }
+  }
+  return BOT_KIND_COUNT;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "world.h"
+
+// Plays the game in place of the keyboard: looks at the world before every
+// tick and returns the keys to hold. A bot only reads the world it plays
+// and its own state, so any number of them can run side by side.
+struct BotPolicy {
+  virtual ~BotPolicy() = default;
+  virtual Input decide(const World &world) = 0;
+};
+
+enum BotKind {
+  // Never moves.
+  BOT_STILL,
+  // Walks a circle of CIRCLE_PERIOD ticks.
+  BOT_CIRCLE,
+  // Runs away from the enemies within KITE_RADIUS, the closer the harder
+  // they push, and circles like BOT_CIRCLE while none are near.
+  BOT_KITE,
+  BOT_KIND_COUNT
+};
+
+extern const char *const BOT_NAMES[BOT_KIND_COUNT];
+
+constexpr int CIRCLE_PERIOD = 600;
+constexpr float KITE_RADIUS = 300;
+
+std::unique_ptr<BotPolicy> make_bot(BotKind kind);
+
+// Kind named `name`, or BOT_KIND_COUNT if there is none.
+BotKind bot_kind(const char *name);
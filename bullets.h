@@ -0,0 +1,111 @@
+#pragma once
+
+#include <utility>
+
+#include "raylib.h"
+
+// Kinds of bullet, as stored in BulletColumns::typ. Everything a kind does
+// differently lives in its BulletTraits, which the steering pass is
+// instantiated with once per kind, so nothing in the per-bullet loop tests
+// the kind. A new kind is a new value before BULLET_KIND_END and a
+// specialization of BulletTraits; spawning, arming, steering and drawing
+// pick it up.
+enum BulletKind {
+  BULLET_STRAIGHT = 1,
+  BULLET_HOMING,
+  // Homing, turns harder as the player levels up and goes through three
+  // enemies.
+  BULLET_HEAVY,
+  // Circles the player.
+  BULLET_ORBIT,
+  BULLET_KIND_END
+};
+
+constexpr int BULLET_KINDS = BULLET_KIND_END - BULLET_STRAIGHT;
+
+// What a bullet does when it has no target to follow.
+enum class BulletSeek {
+  // Keeps its velocity.
+  NONE,
+  // Locks on to the nearest on-screen enemy.
+  NEAREST,
+  // Turns around the player at ORBIT_RADIUS.
+  ORBIT,
+};
+
+constexpr float ORBIT_RADIUS = 128;
+
+// How a kind is drawn: a regular polygon of `sides` sides and `radius`,
+// turned towards the bullet's heading if `faces` is set.
+struct BulletShape {
+  int sides;
+  float radius;
+  bool faces;
+};
+
+// Each kind provides its damage, how many hits it takes to use it up, how
+// it seeks, its shape, and turn(dv, to, d, level): the velocity after
+// steering towards a target `to` away at distance `d`. turn() is also
+// called with the far away slot 0 when nothing was found, which makes it a
+// negligible nudge.
+template <BulletKind K> struct BulletTraits;
+
+template <> struct BulletTraits<BULLET_STRAIGHT> {
+  static constexpr int damage = 10;
+  static constexpr int lifetime = 1;
+  static constexpr BulletSeek seek = BulletSeek::NONE;
+  static constexpr BulletShape shape = {36, 4, false};
+  static Vector2 turn(Vector2 dv, Vector2, float, float) { return dv; }
+};
+
+template <> struct BulletTraits<BULLET_HOMING> {
+  static constexpr int damage = 50;
+  static constexpr int lifetime = 1;
+  static constexpr BulletSeek seek = BulletSeek::NEAREST;
+  static constexpr BulletShape shape = {3, 8, true};
+  static Vector2 turn(Vector2 dv, Vector2 to, float d, float) {
+    auto dx = 3 * to.x / d;
+    auto dy = 3 * to.y / d;
+    dv.x += 0.1 * dx;
+    dv.y += 0.1 * dy;
+    return dv;
+  }
+};
+
+template <> struct BulletTraits<BULLET_HEAVY> {
+  static constexpr int damage = 20;
+  static constexpr int lifetime = 3;
+  static constexpr BulletSeek seek = BulletSeek::NEAREST;
+  static constexpr BulletShape shape = {4, 8, true};
+  static Vector2 turn(Vector2 dv, Vector2 to, float d, float level) {
+    auto dx = (3 + level * 0.1f) * to.x / d;
+    auto dy = (3 + level * 0.1f) * to.y / d;
+    return Vector2{(dv.x + dx) * 0.5f, (dv.y + dy) * 0.5f};
+  }
+};
+
+template <> struct BulletTraits<BULLET_ORBIT> {
+  static constexpr int damage = 15;
+  static constexpr int lifetime = 1;
+  static constexpr BulletSeek seek = BulletSeek::ORBIT;
+  static constexpr BulletShape shape = {6, 8, false};
+  static Vector2 turn(Vector2 dv, Vector2, float, float) { return dv; }
+};
+
+// Calls f(std::integral_constant<BulletKind, K>{}) for every kind, in order.
+template <typename F> constexpr void for_each_bullet_kind(F &&f) {
+  [&]<int... I>(std::integer_sequence<int, I...>) {
+    (f(std::integral_constant<BulletKind, BulletKind(BULLET_STRAIGHT + I)>{}),
+     ...);
+  }(std::make_integer_sequence<int, BULLET_KINDS>{});
+}
+
+// BulletTraits<K>::shape at index K, for code that gets the kind at run time.
+inline constexpr auto BULLET_SHAPES = [] {
+  struct Table {
+    BulletShape of[BULLET_KIND_END];
+  } table{};
+  for_each_bullet_kind(
+      [&](auto kind) { table.of[kind()] = BulletTraits<kind()>::shape; });
+  return table;
+}();
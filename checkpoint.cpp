@@ -0,0 +1,216 @@
+#include "checkpoint.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/uio.h>
+#define CHECKPOINT_WRITEV
+#endif
+
+constexpr char MAGIC[4] = {'V', 'S', 'C', 'K'};
+// Bump with every change to Header or to the arena layout: what World
+// allocates from its arena, in which order and how big.
+constexpr uint32_t VERSION = 4;
+// The arena image starts here, so it can be mapped page by page.
+constexpr size_t PAGE = 4096;
+
+struct PoolState {
+  int32_t count;
+  int32_t free_count;
+  int32_t fresh;
+  int32_t dying_count;
+};
+
+struct Header {
+  char magic[4];
+  uint32_t version;
+  uint32_t header_size;
+  uint32_t cell_size;
+  int32_t capacity;
+  uint64_t arena_bytes;
+
+  PoolState enemies;
+  PoolState bullets;
+  PoolState experiences;
+  PoolState items;
+  Rocket rocket;
+  Boss boss;
+  int32_t rocket_exploded;
+  uint8_t rocket_target_locked;
+  Handle rocket_target;
+  Vector2 player;
+  int32_t player_hp;
+  int32_t player_speed;
+  uint64_t player_experience;
+  uint64_t player_level;
+  int32_t player_dir;
+  int32_t player_launches;
+  uint64_t frame_counter;
+  uint8_t game_over;
+  int32_t view_w;
+  int32_t view_h;
+  uint64_t rng;
+  uint32_t cells_generation;
+  int32_t cells_used;
+  int32_t merge_cursor;
+};
+
+static_assert(std::is_trivially_copyable_v<Header>);
+static_assert(sizeof(Header) <= PAGE);
+
+template <typename P> static PoolState pool_state(const P &pool) {
+  return PoolState{pool.count, pool.free_count, pool.fresh, pool.dying_count};
+}
+
+template <typename P> static void restore(P &pool, const PoolState &state) {
+  pool.count = state.count;
+  pool.free_count = state.free_count;
+  pool.fresh = state.fresh;
+  pool.dying_count = state.dying_count;
+}
+
+using File = std::unique_ptr<FILE, decltype(&fclose)>;
+
+// Writes the header page and then `bytes` of `image` to `f`, which has not
+// been written through stdio. With writev() both parts go to the kernel in
+// one call, straight from the arena; a regular file only takes less than
+// asked past about 2 GiB, and the rest follows in further calls.
+static bool write_image(FILE *f, const uint8_t *page, const uint8_t *image,
+                        size_t bytes) {
+#if defined(CHECKPOINT_WRITEV)
+  iovec parts[2] = {{const_cast<uint8_t *>(page), PAGE},
+                    {const_cast<uint8_t *>(image), bytes}};
+  auto part = parts;
+  int left = 2;
+  while (left > 0) {
+    auto n = writev(fileno(f), part, left);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    while (left > 0 && size_t(n) >= part->iov_len) {
+      n -= part->iov_len;
+      ++part;
+      --left;
+    }
+    if (left > 0) {
+      part->iov_base = static_cast<uint8_t *>(part->iov_base) + n;
+      part->iov_len -= n;
+    }
+  }
+  return true;
+#else
+  setvbuf(f, nullptr, _IONBF, 0);
+  return fwrite(page, 1, PAGE, f) == PAGE &&
+         fwrite(image, 1, bytes, f) == bytes;
+#endif
+}
+
+bool save_checkpoint(const World &world, const char *path) {
+  File f(fopen(path, "wb"), &fclose);
+  if (!f) {
+    return false;
+  }
+  // The page goes out whole, padding included, so equal worlds give equal
+  // files. Value-initializing the header wouldn't zero its padding.
+  uint8_t page[PAGE] = {};
+  Header h;
+  std::memset(static_cast<void *>(&h), 0, sizeof h);
+  std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+  h.version = VERSION;
+  h.header_size = sizeof(Header);
+  h.cell_size = sizeof(*world.gem_cells.entries);
+  h.capacity = world.capacity();
+  h.arena_bytes = world.arena.used();
+  h.enemies = pool_state(world.enemies);
+  h.bullets = pool_state(world.bullets);
+  h.experiences = pool_state(world.experiences);
+  h.items = pool_state(world.items);
+  h.rocket.pos = world.rocket.pos;
+  h.rocket.dv = world.rocket.dv;
+  h.rocket.alive = world.rocket.alive;
+  h.boss.pos = world.boss.pos;
+  h.boss.hp = world.boss.hp;
+  h.boss.alive = world.boss.alive;
+  h.rocket_exploded = world.rocket_exploded;
+  h.rocket_target_locked = world.rocket_target_locked;
+  h.rocket_target = world.rocket_target;
+  h.player = world.player;
+  h.player_hp = world.player_hp;
+  h.player_speed = world.player_speed;
+  h.player_experience = world.player_experience;
+  h.player_level = world.player_level;
+  h.player_dir = world.player_dir;
+  h.player_launches = world.player_launches;
+  h.frame_counter = world.frame_counter;
+  h.game_over = world.game_over;
+  h.view_w = world.view_w;
+  h.view_h = world.view_h;
+  h.rng = world.rng.state;
+  h.cells_generation = world.gem_cells.generation;
+  h.cells_used = world.gem_cells.used;
+  h.merge_cursor = world.merge_cursor;
+  std::memcpy(page, &h, sizeof(h));
+
+  return write_image(f.get(), page, world.arena.data(), h.arena_bytes);
+}
+
+std::unique_ptr<World> load_checkpoint(const char *path) {
+  File f(fopen(path, "rb"), &fclose);
+  if (!f) {
+    return nullptr;
+  }
+  Header h;
+  if (fread(&h, sizeof(h), 1, f.get()) != 1 ||
+      std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) || h.version != VERSION ||
+      h.header_size != sizeof(Header) || h.capacity <= 0) {
+    return nullptr;
+  }
+  // Mapping past the end of the file would fault on first touch.
+  if (fseek(f.get(), 0, SEEK_END) ||
+      uint64_t(ftell(f.get())) != PAGE + h.arena_bytes) {
+    return nullptr;
+  }
+  auto world = std::make_unique<World>(0, h.capacity);
+  if (h.cell_size != sizeof(*world->gem_cells.entries) ||
+      h.arena_bytes != world->arena.used() ||
+      !world->arena.map(f.get(), PAGE, h.arena_bytes)) {
+    return nullptr;
+  }
+
+  auto &w = *world;
+  restore(w.enemies, h.enemies);
+  restore(w.bullets, h.bullets);
+  restore(w.experiences, h.experiences);
+  restore(w.items, h.items);
+  w.rocket.pos = h.rocket.pos;
+  w.rocket.dv = h.rocket.dv;
+  w.rocket.alive = h.rocket.alive;
+  w.boss.pos = h.boss.pos;
+  w.boss.hp = h.boss.hp;
+  w.boss.alive = h.boss.alive;
+  w.rocket_exploded = h.rocket_exploded;
+  w.rocket_target_locked = h.rocket_target_locked;
+  w.rocket_target = h.rocket_target;
+  w.player = h.player;
+  w.player_hp = h.player_hp;
+  w.player_speed = h.player_speed;
+  w.player_experience = h.player_experience;
+  w.player_level = h.player_level;
+  w.player_dir = h.player_dir;
+  w.player_launches = h.player_launches;
+  w.frame_counter = h.frame_counter;
+  w.game_over = h.game_over;
+  w.view_w = h.view_w;
+  w.view_h = h.view_h;
+  w.rng.state = h.rng;
+  w.gem_cells.generation = h.cells_generation;
+  w.gem_cells.used = h.cells_used;
+  w.merge_cursor = h.merge_cursor;
+  return world;
+}
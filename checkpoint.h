@@ -0,0 +1,24 @@
+#pragma once
+
+#include <memory>
+
+#include "world.h"
+
+// Whole-world checkpoints. The file is one page of header, holding every
+// scalar of the World in a fixed POD layout, followed by a byte-for-byte
+// image of the World's arena, which holds every pool column. Loading builds
+// a World of the same capacity, whose arena then has the same layout, and
+// maps the image over it: nothing is parsed or converted, and pages are only
+// read once the simulation touches them.
+//
+// The layout is that of the machine and build that wrote the file; the
+// header records enough sizes to reject a file from a different one. Two
+// worlds that went through the same ticks write identical files, so `cmp`
+// is enough to diff them.
+
+// Returns false on I/O errors.
+bool save_checkpoint(const World &world, const char *path);
+
+// Returns null on I/O errors or a file that doesn't match this build. The
+// world has no jobs, timing or profiler attached.
+std::unique_ptr<World> load_checkpoint(const char *path);
@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "batch.h"
+#include "grid.h"
+#include "render.h"
+#include "snapshot.h"
+#include "world.h"
+
+// Headless checks of behaviour the game relies on but can't show on its
+// own, run by ctest. Prints every failed check and exits with 1 if any did.
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+  if (!ok) {
+    fmt::print(stderr, "FAILED: {}\n", what);
+    failures += 1;
+  }
+}
+
+// Two cells of one 3x3 block that land in the same bucket must not report
+// the points in that bucket twice, and neither must a point that moved
+// twice since the last build.
+static void spatial_hash_reports_once() {
+  SpatialHash grid(64);
+  // Block around (bx, by) with cell (cx, cy) sharing a bucket with another
+  // of its cells.
+  int bx = 0;
+  int by = 0;
+  int cx = 0;
+  int cy = 0;
+  auto find = [&] {
+    for (by = 0; by < 400; ++by) {
+      for (bx = 0; bx < 400; ++bx) {
+        for (int i = 0; i < 9; ++i) {
+          for (int j = i + 1; j < 9; ++j) {
+            cx = bx + i % 3 - 1;
+            cy = by + i / 3 - 1;
+            if (grid.bucket(cx, cy) ==
+                grid.bucket(bx + j % 3 - 1, by + j / 3 - 1)) {
+              return true;
+            }
+          }
+        }
+      }
+    }
+    return false;
+  };
+  check(find(), "some 3x3 block has two cells in one bucket");
+
+  auto center = [&](int x, int y) {
+    return Vector2{(x + 0.5f) * grid.cell_size, (y + 0.5f) * grid.cell_size};
+  };
+  grid.clear();
+  grid.insert(0, center(cx, cy));
+  grid.build();
+  int reports = 0;
+  grid.query(center(bx, by), grid.cell_size, [&](int) { reports += 1; });
+  check(reports == 1, "a point in a shared bucket is reported once");
+
+  auto away = center(cx + 5, cy + 5);
+  grid.relocate(0, center(cx, cy), away);
+  grid.relocate(0, away, center(cx + 9, cy + 9));
+  reports = 0;
+  grid.query(center(cx + 9, cy + 9), grid.cell_size,
+             [&](int) { reports += 1; });
+  check(reports == 1, "a point that moved twice is reported once");
+
+  // A blast-sized square covers hundreds of cells, more than one per bucket
+  // in places, and must still report every point in it exactly once.
+  grid.clear();
+  for (int i = 0; i < 400; ++i) {
+    grid.insert(i, Vector2{float(i % 20) * 50 - 500, float(i / 20) * 50 - 500});
+  }
+  grid.build();
+  std::vector<int> seen(400, 0);
+  grid.query(Vector2{0, 0}, 500, [&](int idx) { seen[idx] += 1; });
+  check(std::all_of(seen.begin(), seen.end(), [](int n) { return n == 1; }),
+        "a large square reports each point once");
+}
+
+// A known scene through draw_entities must come out as one submission per
+// layer: gems and items, enemies, bullets. Polygons are a triangle per side,
+// sprites a quad and squares two triangles.
+static void entities_batch_per_layer() {
+  World world(1, 64);
+  for (int i = 0; i < 2; ++i) {
+    auto g = world.experiences.spawn();
+    world.experiences.x[g] = 100 + 20 * i;
+    world.experiences.y[g] = 100;
+    world.experiences.value[g] = 1;
+    world.experiences.typ[g] = 0;
+  }
+  auto item = world.items.spawn();
+  world.items.pos[item] = Vector2{-100, 100};
+  world.items.typ[item] = 1;
+  for (int i = 0; i < 3; ++i) {
+    world.spawn_enemy(Vector2{200 + 40.0f * i, -200}, 10);
+  }
+  for (int k = BULLET_STRAIGHT; k < BULLET_KIND_END; ++k) {
+    world.spawn_bullet(Vector2{10.0f * k, 0}, Vector2{1, 0}, BulletKind(k));
+  }
+  Snapshot snap;
+  snap.capture(world);
+
+  SpriteBatch batch;
+  CountingBackend counter;
+  Texture2D atlas{1, 256, 256, 1, 0};
+  Rectangle enemy_sprite{0, 0, 32, 32};
+  EntityDetail full;
+  draw_entities(snap, snap, 0.5f, atlas, enemy_sprite, full, batch, counter);
+  check(counter.draw_calls == 3, "full detail: one draw call per layer");
+  // Gems 2 hexagons and the item a square polygon; 3 enemy quads; a
+  // circle, a triangle, a square and a hexagon bullet.
+  auto layers = (2 * 6 + 4) * 3 + 3 * 4 + (36 + 3 + 4 + 6) * 3;
+  check(counter.vertices == layers, "full detail: vertices of the scene");
+
+  counter.reset();
+  EntityDetail points;
+  points.points = true;
+  draw_entities(snap, snap, 0.5f, atlas, enemy_sprite, points, batch,
+                counter);
+  check(counter.draw_calls == 3, "points: one draw call per layer");
+  check(counter.vertices == 3 * 6 + 3 * 4 + 4 * 6,
+        "points: two triangles per gem, item and bullet");
+
+  // A layer with nothing in it is not submitted.
+  World lone(1, 64);
+  lone.spawn_enemy(Vector2{0, 0}, 10);
+  snap.capture(lone);
+  counter.reset();
+  draw_entities(snap, snap, 0.5f, atlas, enemy_sprite, full, batch, counter);
+  check(counter.draw_calls == 1 && counter.vertices == 4,
+        "empty layers: only the enemy quad");
+}
+
+int main() {
+  spatial_hash_reports_once();
+  entities_batch_per_layer();
+  if (failures) {
+    fmt::print(stderr, "{} checks failed\n", failures);
+    return 1;
+  }
+  fmt::print("all checks passed\n");
+  return 0;
+}
@@ -0,0 +1,152 @@
+# Packs PNG sprites into one atlas and writes its layout and the embedded
+# PNG data as C++ sources. Run in script mode:
+#
+#   cmake -DSPRITES="name=file.png;..." -DOUT_DIR=dir -P atlas.cmake
+#
+# Writes OUT_DIR/atlas_data.h, with a Sprite enum (SPRITE_<NAME> in the
+# order given) and the rectangle of every sprite in the atlas, and
+# OUT_DIR/atlas_data.cpp, with the PNG files themselves. Sprites are placed
+# on shelves, tallest first, PADDING pixels apart so filtering never blends
+# in a neighbor. The atlas is ATLAS_WIDTH wide, or the widest sprite if
+# that is wider, and as tall as the shelves need, both rounded up to a
+# power of two.
+
+set(PADDING 2)
+set(ATLAS_WIDTH 256)
+
+# Big-endian 32-bit integer from 8 hex digits.
+function(hex_to_int hex out)
+    set(value 0)
+    string(LENGTH "${hex}" length)
+    math(EXPR last "${length} - 1")
+    foreach (i RANGE 0 ${last})
+        string(SUBSTRING "${hex}" ${i} 1 digit)
+        string(FIND "0123456789abcdef" "${digit}" d)
+        math(EXPR value "${value} * 16 + ${d}")
+    endforeach ()
+    set(${out} ${value} PARENT_SCOPE)
+endfunction()
+
+function(next_pow2 n out)
+    set(p 1)
+    while (p LESS n)
+        math(EXPR p "${p} * 2")
+    endwhile ()
+    set(${out} ${p} PARENT_SCOPE)
+endfunction()
+
+# Width and height from the IHDR chunk, which always comes first.
+set(keys "")
+set(width ${ATLAS_WIDTH})
+foreach (entry ${SPRITES})
+    string(REPLACE "=" ";" pair "${entry}")
+    list(GET pair 0 name)
+    list(GET pair 1 file)
+    file(READ "${file}" header LIMIT 8 HEX)
+    if (NOT header STREQUAL "89504e470d0a1a0a")
+        message(FATAL_ERROR "${file} is not a PNG")
+    endif ()
+    file(READ "${file}" size OFFSET 16 LIMIT 8 HEX)
+    string(SUBSTRING "${size}" 0 8 w_hex)
+    string(SUBSTRING "${size}" 8 8 h_hex)
+    hex_to_int(${w_hex} w)
+    hex_to_int(${h_hex} h)
+    set(sprite_${name}_w ${w})
+    set(sprite_${name}_h ${h})
+    set(sprite_${name}_file "${file}")
+    if (w GREATER width)
+        set(width ${w})
+    endif ()
+    # Zero-padded heights sort as numbers.
+    set(key "${h}")
+    string(LENGTH "${key}" digits)
+    while (digits LESS 8)
+        set(key "0${key}")
+        math(EXPR digits "${digits} + 1")
+    endwhile ()
+    list(APPEND keys "${key}:${name}")
+endforeach ()
+next_pow2(${width} width)
+list(SORT keys)
+list(REVERSE keys)
+
+set(x 0)
+set(y 0)
+set(shelf 0)
+foreach (key ${keys})
+    string(REGEX REPLACE "^[0-9]+:" "" name "${key}")
+    set(w ${sprite_${name}_w})
+    set(h ${sprite_${name}_h})
+    math(EXPR right "${x} + ${w}")
+    if (right GREATER width)
+        math(EXPR y "${y} + ${shelf} + ${PADDING}")
+        set(x 0)
+        set(shelf 0)
+    endif ()
+    set(sprite_${name}_x ${x})
+    set(sprite_${name}_y ${y})
+    math(EXPR x "${x} + ${w} + ${PADDING}")
+    if (h GREATER shelf)
+        set(shelf ${h})
+    endif ()
+endforeach ()
+math(EXPR height "${y} + ${shelf}")
+next_pow2(${height} height)
+
+# Sixteen bytes a line.
+set(row "")
+foreach (i RANGE 1 16)
+    string(APPEND row "0x..,")
+endforeach ()
+
+set(enum "")
+set(table "")
+set(data "")
+foreach (entry ${SPRITES})
+    string(REPLACE "=" ";" pair "${entry}")
+    list(GET pair 0 name)
+    string(TOUPPER "${name}" upper)
+    string(APPEND enum "  SPRITE_${upper},\n")
+    file(READ "${sprite_${name}_file}" bytes HEX)
+    string(LENGTH "${bytes}" length)
+    math(EXPR length "${length} / 2")
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," bytes "${bytes}")
+    string(REGEX REPLACE "(${row})" "\\1\n    " bytes "${bytes}")
+    string(APPEND data
+           "static const unsigned char ${name}_png[] = {\n    ${bytes}\n};\n\n")
+    string(APPEND table
+           "    {${sprite_${name}_x}, ${sprite_${name}_y}, "
+           "${sprite_${name}_w}, ${sprite_${name}_h}, ${name}_png, "
+           "${length}},\n")
+endforeach ()
+
+file(WRITE "${OUT_DIR}/atlas_data.h"
+"// Generated by cmake/atlas.cmake, do not edit.
+#pragma once
+
+enum Sprite {
+${enum}  SPRITE_COUNT
+};
+
+constexpr int ATLAS_WIDTH = ${width};
+constexpr int ATLAS_HEIGHT = ${height};
+
+// Where a sprite goes in the atlas, and its PNG file.
+struct AtlasSprite {
+  int x;
+  int y;
+  int width;
+  int height;
+  const unsigned char *png;
+  int png_size;
+};
+
+extern const AtlasSprite ATLAS_SPRITES[SPRITE_COUNT];
+")
+file(WRITE "${OUT_DIR}/atlas_data.cpp"
+"// Generated by cmake/atlas.cmake, do not edit.
+#include \"atlas_data.h\"
+
+${data}const AtlasSprite ATLAS_SPRITES[SPRITE_COUNT] = {
+${table}};
+")
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+
+// Effects found by a detection pass and applied later by World::resolve,
+// in the order they sit in the buffer. Detection only reads the world, so
+// it can run in parallel with each chunk writing its own stretch of the
+// buffer; packing the stretches in chunk order keeps the result independent
+// of the number of threads.
+enum EventType : uint8_t {
+  // Bullet `subject` hits enemy `object`.
+  EVENT_HIT,
+  // Bullet `subject` hits the boss.
+  EVENT_BOSS_HIT,
+  // Enemy `subject` dies and drops its experience.
+  EVENT_KILL,
+  // The player picks up gem `subject`.
+  EVENT_PICKUP,
+};
+
+struct Event {
+  EventType type;
+  int subject;
+  int object;
+};
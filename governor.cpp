@@ -0,0 +1,51 @@
+#include "governor.h"
+
+#include <algorithm>
+
+const char *const Governor::LEVEL_NAMES[LEVEL_COUNT] = {
+    "full", "unrotated", "points", "coarse", "coarser",
+};
+
+Governor::Governor(int target_fps) {
+  stats.target_fps = target_fps > 0 ? target_fps : 60;
+  stats.budget_ms = 1000 / stats.target_fps;
+}
+
+void Governor::frame(uint64_t ns) {
+  window[filled++] = ns;
+  if (filled < WINDOW) {
+    return;
+  }
+  filled = 0;
+  auto p90 = window + WINDOW * 9 / 10;
+  std::nth_element(window, p90, window + WINDOW);
+  stats.p90_ms = *p90 / 1e6;
+  auto load = stats.p90_ms / stats.budget_ms;
+  if (load > HIGH) {
+    calm = 0;
+    if (stats.level + 1 < LEVEL_COUNT) {
+      stats.level = Level(stats.level + 1);
+      stats.drops += 1;
+    }
+  } else if (load < LOW) {
+    calm += 1;
+    if (calm >= CALM && stats.level > FULL) {
+      stats.level = Level(stats.level - 1);
+      stats.raises += 1;
+      calm = 0;
+    }
+  } else {
+    calm = 0;
+  }
+}
+
+EntityDetail Governor::entity_detail() const {
+  EntityDetail detail;
+  detail.rotate_bullets = stats.level < UNROTATED;
+  detail.points = stats.level >= POINTS;
+  return detail;
+}
+
+int Governor::background_coarser() const {
+  return std::max(0, stats.level - POINTS);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+
+#include "render.h"
+
+// Trades drawing detail for frame time. Every frame reports how long it
+// worked, not counting the wait for the next frame in EndDrawing, and every
+// WINDOW frames the governor looks at the 90th percentile of those against
+// the budget of the target frame rate. Above HIGH of the budget it drops a
+// quality level right away; below LOW for CALM windows in a row it climbs
+// back one, so a level is not given up for a single spike or taken back at
+// the first quiet moment.
+//
+// Only drawing is governed. The simulation keeps its own fixed tick on its
+// own thread, and anything that changed what it spawns would change the
+// game and break replays.
+struct Governor {
+  static constexpr int WINDOW = 30;
+  static constexpr double HIGH = 0.85;
+  static constexpr double LOW = 0.5;
+  static constexpr int CALM = 4;
+
+  // From full detail down, each level keeps the savings of the ones above.
+  enum Level {
+    // Everything as designed.
+    FULL,
+    // Bullets keep one orientation instead of turning towards their heading.
+    UNROTATED,
+    // Gems, items and bullets are plain squares.
+    POINTS,
+    // The background is drawn from chunks one level coarser than the zoom
+    // calls for.
+    COARSE,
+    // Two levels coarser.
+    COARSER,
+    LEVEL_COUNT
+  };
+
+  struct Stats {
+    Level level = FULL;
+    double target_fps = 60;
+    double budget_ms = 0;
+    // 90th percentile of the work per frame in the last window.
+    double p90_ms = 0;
+    // Level changes so far.
+    int drops = 0;
+    int raises = 0;
+  };
+
+  explicit Governor(int target_fps);
+
+  // Counts one frame that worked `ns` nanoseconds.
+  void frame(uint64_t ns);
+
+  Level level() const { return stats.level; }
+  EntityDetail entity_detail() const;
+  // Levels the background goes above the one the zoom picks.
+  int background_coarser() const;
+
+  Stats stats;
+
+  static const char *const LEVEL_NAMES[LEVEL_COUNT];
+
+private:
+  uint64_t window[WINDOW] = {};
+  int filled = 0;
+  int calm = 0;
+};
@@ -0,0 +1,279 @@
+#include "grid.h"
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+
+SpatialHash::SpatialHash(float cell_size, int bucket_bits)
+    : cell_size(cell_size),
+      mask((1u << std::min(bucket_bits, MAX_BUCKET_BITS)) - 1),
+      bucket_start(size_t(mask) + 2, 0) {}
+
+void SpatialHash::reserve(int capacity) {
+  bucket_items.reserve(capacity);
+  item_bucket.resize(std::max(item_bucket.size(), size_t(capacity)));
+  item_moved.resize(std::max(item_moved.size(), size_t(capacity)));
+  pending.reserve(capacity);
+  moved.reserve(capacity);
+}
+
+void SpatialHash::clear() {
+  pending.clear();
+  forget_moved();
+}
+
+void SpatialHash::forget_moved() {
+  for (auto idx : moved) {
+    item_moved[idx] = 0;
+  }
+  moved.clear();
+}
+
+SpatialHash::QueryMarks &SpatialHash::query_marks() {
+  // Static storage, so a job thread's first query doesn't allocate. Stamps
+  // are never reused on a thread, so one set of marks serves every hash it
+  // queries.
+  static thread_local QueryMarks marks{};
+  marks.stamp += 1;
+  if (marks.stamp == 0) {
+    std::fill(std::begin(marks.scanned), std::end(marks.scanned), 0);
+    marks.stamp = 1;
+  }
+  return marks;
+}
+
+void SpatialHash::insert(int idx, Vector2 pos) {
+  if (idx >= int(item_bucket.size())) {
+    item_bucket.resize(idx + 1);
+    item_moved.resize(idx + 1);
+  }
+  item_bucket[idx] = bucket(cell(pos.x), cell(pos.y));
+  pending.push_back(idx);
+}
+
+void SpatialHash::build() {
+  std::fill(bucket_start.begin(), bucket_start.end(), 0);
+  for (auto idx : pending) {
+    bucket_start[item_bucket[idx] + 1] += 1;
+  }
+  for (size_t b = 1; b < bucket_start.size(); ++b) {
+    bucket_start[b] += bucket_start[b - 1];
+  }
+  bucket_items.resize(pending.size());
+  // The scatter advances bucket_start[b] from the start of bucket b to its
+  // end, which is the start of bucket b + 1, so shift it back afterwards.
+  for (auto idx : pending) {
+    bucket_items[bucket_start[item_bucket[idx]]++] = idx;
+  }
+  for (size_t b = bucket_start.size() - 1; b > 0; --b) {
+    bucket_start[b] = bucket_start[b - 1];
+  }
+  bucket_start[0] = 0;
+  forget_moved();
+}
+
+void SpatialHash::relocate(int idx, Vector2 old_pos, Vector2 new_pos) {
+  if (cell(old_pos.x) != cell(new_pos.x) ||
+      cell(old_pos.y) != cell(new_pos.y)) {
+    if (!item_moved[idx]) {
+      item_moved[idx] = 1;
+      moved.push_back(idx);
+    }
+  }
+}
+
+void NeighborGrid::reserve(int capacity, int max_cells) {
+  cell_start.reserve(size_t(max_cells) + 1);
+  items.reserve(capacity);
+  x.reserve(capacity + KERNEL_WIDTH);
+  y.reserve(capacity + KERNEL_WIDTH);
+  item_cell.reserve(capacity);
+}
+
+void NeighborGrid::build(const float *px, const float *py,
+                         const uint8_t *alive, int n, float size,
+                         int max_cells) {
+  auto min_x = std::numeric_limits<float>::max();
+  auto min_y = min_x;
+  auto max_x = std::numeric_limits<float>::lowest();
+  auto max_y = max_x;
+  int live = 0;
+  for (int i = 0; i < n; ++i) {
+    if (alive[i]) {
+      min_x = std::min(min_x, px[i]);
+      min_y = std::min(min_y, py[i]);
+      max_x = std::max(max_x, px[i]);
+      max_y = std::max(max_y, py[i]);
+      live += 1;
+    }
+  }
+  if (!live) {
+    min_x = min_y = max_x = max_y = 0;
+  }
+  // A crowd spread thin over a big area gets coarser cells, which keeps
+  // the build O(points + max_cells).
+  auto w = double(max_x) - min_x;
+  auto h = double(max_y) - min_y;
+  double cell = std::max(double(size), std::sqrt(w * h / max_cells));
+  while ((std::floor(w / cell) + 1) * (std::floor(h / cell) + 1) >
+         max_cells) {
+    cell *= 2;
+  }
+  x0 = min_x;
+  y0 = min_y;
+  cell_size = float(cell);
+  cols = int(w / cell) + 1;
+  rows = int(h / cell) + 1;
+
+  cell_start.assign(size_t(cols) * rows + 1, 0);
+  item_cell.resize(n);
+  for (int i = 0; i < n; ++i) {
+    if (alive[i]) {
+      auto cx = std::min(int((px[i] - x0) / cell_size), cols - 1);
+      auto cy = std::min(int((py[i] - y0) / cell_size), rows - 1);
+      item_cell[i] = cy * cols + cx;
+      cell_start[item_cell[i] + 1] += 1;
+    }
+  }
+  for (size_t c = 1; c < cell_start.size(); ++c) {
+    cell_start[c] += cell_start[c - 1];
+  }
+  items.resize(live);
+  x.resize(live + KERNEL_WIDTH);
+  y.resize(live + KERNEL_WIDTH);
+  for (int i = 0; i < n; ++i) {
+    if (alive[i]) {
+      auto slot = cell_start[item_cell[i]]++;
+      items[slot] = i;
+      x[slot] = px[i];
+      y[slot] = py[i];
+    }
+  }
+  for (size_t c = cell_start.size() - 1; c > 0; --c) {
+    cell_start[c] = cell_start[c - 1];
+  }
+  cell_start[0] = 0;
+}
+
+int PointGrid::col(float x) const {
+  return int(std::clamp((x - bounds.x) / cell_size, 0.0f, float(cols - 1)));
+}
+
+int PointGrid::row(float y) const {
+  return int(std::clamp((y - bounds.y) / cell_size, 0.0f, float(rows - 1)));
+}
+
+void PointGrid::reserve(int capacity) {
+  items.reserve(capacity);
+  item_pos.reserve(capacity);
+  pending.reserve(capacity);
+  pending_pos.reserve(capacity);
+  pending_cell.reserve(capacity);
+}
+
+void PointGrid::clear(Rectangle b, float size) {
+  bounds = b;
+  cell_size = size;
+  cols = std::max(1, int(std::ceil(b.width / size)));
+  rows = std::max(1, int(std::ceil(b.height / size)));
+  pending.clear();
+  pending_pos.clear();
+  pending_cell.clear();
+}
+
+void PointGrid::insert(int idx, Vector2 pos) {
+  pending.push_back(idx);
+  pending_pos.push_back(pos);
+  pending_cell.push_back(row(pos.y) * cols + col(pos.x));
+}
+
+void PointGrid::build() {
+  cell_start.assign(cols * rows + 1, 0);
+  for (auto c : pending_cell) {
+    cell_start[c + 1] += 1;
+  }
+  for (size_t c = 1; c < cell_start.size(); ++c) {
+    cell_start[c] += cell_start[c - 1];
+  }
+  items.resize(pending.size());
+  item_pos.resize(pending.size());
+  for (size_t i = 0; i < pending.size(); ++i) {
+    auto slot = cell_start[pending_cell[i]]++;
+    items[slot] = pending[i];
+    item_pos[slot] = pending_pos[i];
+  }
+  for (size_t c = cell_start.size() - 1; c > 0; --c) {
+    cell_start[c] = cell_start[c - 1];
+  }
+  cell_start[0] = 0;
+}
+
+int PointGrid::nearest(Vector2 pos) const {
+  if (items.empty()) {
+    return -1;
+  }
+  int best = -1;
+  auto best_d2 = std::numeric_limits<float>::max();
+  auto cx = col(pos.x);
+  auto cy = row(pos.y);
+  auto scan = [&](int x, int y) {
+    auto c = y * cols + x;
+    for (int i = cell_start[c]; i < cell_start[c + 1]; ++i) {
+      auto dx = item_pos[i].x - pos.x;
+      auto dy = item_pos[i].y - pos.y;
+      auto d2 = dx * dx + dy * dy;
+      if (d2 < best_d2 || (d2 == best_d2 && items[i] < best)) {
+        best_d2 = d2;
+        best = items[i];
+      }
+    }
+  };
+  // Ring k holds the cells k steps from (cx, cy), clipped to the grid.
+  for (int k = 0;; ++k) {
+    auto x0 = cx - k;
+    auto x1 = cx + k;
+    auto y0 = cy - k;
+    auto y1 = cy + k;
+    for (int x = std::max(x0, 0); x <= std::min(x1, cols - 1); ++x) {
+      if (y0 >= 0) {
+        scan(x, y0);
+      }
+      if (y1 < rows && k > 0) {
+        scan(x, y1);
+      }
+    }
+    for (int y = std::max(y0 + 1, 0); y <= std::min(y1 - 1, rows - 1);
+         ++y) {
+      if (x0 >= 0 && k > 0) {
+        scan(x0, y);
+      }
+      if (x1 < cols) {
+        scan(x1, y);
+      }
+    }
+    // Whatever is left lies beyond one of the box's sides that is still
+    // inside the grid. Stop once all of those are further than the best.
+    auto left = bounds.x + x0 * cell_size;
+    auto right = bounds.x + (x1 + 1) * cell_size;
+    auto top = bounds.y + y0 * cell_size;
+    auto bottom = bounds.y + (y1 + 1) * cell_size;
+    auto bound = std::numeric_limits<float>::max();
+    if (x0 > 0) {
+      bound = std::min(bound, std::max(0.0f, pos.x - left));
+    }
+    if (x1 < cols - 1) {
+      bound = std::min(bound, std::max(0.0f, right - pos.x));
+    }
+    if (y0 > 0) {
+      bound = std::min(bound, std::max(0.0f, pos.y - top));
+    }
+    if (y1 < rows - 1) {
+      bound = std::min(bound, std::max(0.0f, bottom - pos.y));
+    }
+    if (bound == std::numeric_limits<float>::max() ||
+        bound * bound > best_d2) {
+      break;
+    }
+  }
+  return best;
+}
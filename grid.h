@@ -0,0 +1,275 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "raylib.h"
+
+#include "arena.h"
+#include "kernels.h"
+
+// Uniform spatial hash over a set of indexed points. The whole grid is
+// rebuilt with a counting sort once the points have moved, which keeps every
+// bucket a contiguous run of indices in ascending order. Points that move
+// after the build can be reported with relocate() and stay findable until
+// the next rebuild.
+struct SpatialHash {
+  float cell_size;
+  uint32_t mask;
+  std::vector<int> bucket_start;
+  std::vector<int> bucket_items;
+  std::vector<uint32_t> item_bucket;
+  // Set while an index is listed in `moved`, so it is listed only once.
+  std::vector<uint8_t> item_moved;
+  std::vector<int> pending;
+  std::vector<int> moved;
+
+  // At most MAX_BUCKET_BITS bucket bits.
+  explicit SpatialHash(float cell_size, int bucket_bits = MAX_BUCKET_BITS);
+
+  // Makes room for indices below `capacity`, so that filling the hash never
+  // allocates.
+  void reserve(int capacity);
+  void clear();
+  void insert(int idx, Vector2 pos);
+  void build();
+  // Call when a point moves between rebuilds.
+  void relocate(int idx, Vector2 old_pos, Vector2 new_pos);
+
+  int cell(float v) const { return int(std::floor(v / cell_size)); }
+  uint32_t bucket(int cx, int cy) const {
+    return ((uint32_t(cx) * 73856093u) ^ (uint32_t(cy) * 19349663u)) & mask;
+  }
+
+  // Calls f(idx) once for every point whose cell overlaps the square around
+  // `pos` with half-size `r`. Candidates are not distance-filtered, callers
+  // do the exact test.
+  //
+  // Neighbouring cells can hash to the same bucket, so each bucket is only
+  // scanned the first time one of its cells comes up, and a moved point
+  // only counts when its bucket was not scanned. Buckets are marked with a
+  // per-thread query stamp, which keeps large squares as cheap per cell as
+  // small ones, lets several threads query at once and never allocates.
+  template <typename F> void query(Vector2 pos, float r, F &&f) const {
+    auto x0 = cell(pos.x - r);
+    auto x1 = cell(pos.x + r);
+    auto y0 = cell(pos.y - r);
+    auto y1 = cell(pos.y + r);
+    auto &marks = query_marks();
+    auto stamp = marks.stamp;
+    for (int cy = y0; cy <= y1; ++cy) {
+      for (int cx = x0; cx <= x1; ++cx) {
+        auto b = bucket(cx, cy);
+        if (marks.scanned[b] == stamp) {
+          continue;
+        }
+        marks.scanned[b] = stamp;
+        for (int i = bucket_start[b]; i < bucket_start[b + 1]; ++i) {
+          f(bucket_items[i]);
+        }
+      }
+    }
+    for (auto idx : moved) {
+      if (marks.scanned[item_bucket[idx]] != stamp) {
+        f(idx);
+      }
+    }
+  }
+
+  // Index of the point closest to `pos`, among those within `max_r` for
+  // which accept(idx) holds, or -1. pos_of(idx) gives a point's current
+  // position. Ties go to the lower index.
+  //
+  // Walks rings of cells outwards from `pos` and stops once the next ring
+  // can't hold anything closer than the best so far, which makes it O(1)
+  // on average for a crowd of roughly uniform density. Searches that would
+  // need more than MAX_RINGS rings check every point instead.
+  template <typename P, typename A>
+  int nearest(Vector2 pos, float max_r, P &&pos_of, A &&accept) const {
+    int best = -1;
+    auto best_d2 = max_r * max_r;
+    auto consider = [&](int idx) {
+      auto p = pos_of(idx);
+      auto dx = p.x - pos.x;
+      auto dy = p.y - pos.y;
+      auto d2 = dx * dx + dy * dy;
+      if ((d2 < best_d2 || (d2 == best_d2 && idx < best)) && accept(idx)) {
+        best_d2 = d2;
+        best = idx;
+      }
+    };
+    for (auto idx : moved) {
+      consider(idx);
+    }
+    auto cx = cell(pos.x);
+    auto cy = cell(pos.y);
+    auto visit = [&](int x, int y) {
+      auto b = bucket(x, y);
+      for (int i = bucket_start[b]; i < bucket_start[b + 1]; ++i) {
+        consider(bucket_items[i]);
+      }
+    };
+    for (int k = 0;; ++k) {
+      if (k > MAX_RINGS) {
+        for (auto idx : bucket_items) {
+          consider(idx);
+        }
+        break;
+      }
+      if (k == 0) {
+        visit(cx, cy);
+      } else {
+        for (int x = cx - k; x <= cx + k; ++x) {
+          visit(x, cy - k);
+          visit(x, cy + k);
+        }
+        for (int y = cy - k + 1; y <= cy + k - 1; ++y) {
+          visit(cx - k, y);
+          visit(cx + k, y);
+        }
+      }
+      // Everything beyond ring k is at least k cells away.
+      auto reach = k * cell_size;
+      if (reach * reach > best_d2) {
+        break;
+      }
+    }
+    return best;
+  }
+
+  static constexpr int MAX_RINGS = 24;
+  static constexpr int MAX_BUCKET_BITS = 12;
+
+private:
+  // Buckets scanned by the running query of a thread: those holding its
+  // stamp.
+  struct QueryMarks {
+    uint32_t scanned[1 << MAX_BUCKET_BITS];
+    uint32_t stamp;
+  };
+  // The calling thread's marks, with a fresh stamp.
+  static QueryMarks &query_marks();
+  void forget_moved();
+};
+
+// Uniform grid over a fixed rectangle, filled the same way as SpatialHash.
+// Every cell has a bucket of its own and keeps copies of its points'
+// positions, so a nearest-point search scans contiguous memory and stops
+// exactly at the edge of the rectangle. Inserted points must lie inside
+// `bounds`.
+struct PointGrid {
+  Rectangle bounds{0, 0, 0, 0};
+  float cell_size = 64;
+  int cols = 0;
+  int rows = 0;
+  std::vector<int> cell_start;
+  std::vector<int> items;
+  std::vector<Vector2> item_pos;
+  std::vector<int> pending;
+  std::vector<Vector2> pending_pos;
+  std::vector<int> pending_cell;
+
+  // Makes room for `capacity` points.
+  void reserve(int capacity);
+  void clear(Rectangle bounds, float cell_size);
+  void insert(int idx, Vector2 pos);
+  void build();
+
+  // Index of the point closest to `pos`, ties going to the lower index, or
+  // -1 if the grid is empty.
+  int nearest(Vector2 pos) const;
+
+private:
+  int col(float x) const;
+  int row(float y) const;
+};
+
+// Uniform grid over the bounding box of the live points of a column pair,
+// rebuilt from scratch. Cells are numbered row by row and each cell's points
+// are stored together, in ascending index order, along with copies of their
+// coordinates, so the 3x3 block around a cell is three contiguous runs. The
+// cell size grows past the requested one when that would take more than
+// `max_cells` cells. The coordinate copies are padded with KERNEL_WIDTH
+// entries for the batch kernels.
+struct NeighborGrid {
+  float x0 = 0;
+  float y0 = 0;
+  float cell_size = 64;
+  int cols = 0;
+  int rows = 0;
+  std::vector<int> cell_start;
+  std::vector<int> items;
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<int> item_cell;
+
+  // Makes room for `capacity` points in up to `max_cells` cells.
+  void reserve(int capacity, int max_cells);
+  void build(const float *x, const float *y, const uint8_t *alive, int n,
+             float cell_size, int max_cells);
+
+  // First and one past the last point of cells cx - 1 to cx + 1 of `row`,
+  // clipped to the grid.
+  int run_begin(int cx, int row) const {
+    return cell_start[row * cols + std::max(cx - 1, 0)];
+  }
+  int run_end(int cx, int row) const {
+    return cell_start[row * cols + std::min(cx + 1, cols - 1) + 1];
+  }
+};
+
+// Open-addressing map from grid cells to a V, for passes that keep one entry
+// per occupied cell. Entries are stamped with the generation they were
+// written in and older ones count as empty, so clear() is O(1). The table
+// lives in an arena, V has to be trivially copyable.
+template <typename V> struct CellMap {
+  struct Entry {
+    int cx;
+    int cy;
+    uint32_t stamp;
+    V value;
+  };
+  Entry *entries = nullptr;
+  size_t size = 0;
+  uint32_t generation = 1;
+  int used = 0;
+
+  // Sizes the table for `cells` entries at most half full. The arena hands
+  // out zeroed memory, which reads as all entries empty.
+  void allocate(Arena &arena, int cells) {
+    size = 16;
+    while (size < size_t(cells) * 2) {
+      size *= 2;
+    }
+    entries = arena.make<Entry>(size);
+    generation = 1;
+    used = 0;
+  }
+
+  void clear() {
+    generation += 1;
+    used = 0;
+  }
+
+  bool full() const { return size_t(used) * 2 >= size; }
+
+  // Entry of cell (cx, cy), a default V if the cell is new. Only call when
+  // not full().
+  V &at(int cx, int cy) {
+    auto mask = size - 1;
+    auto i = ((uint32_t(cx) * 73856093u) ^ (uint32_t(cy) * 19349663u)) & mask;
+    for (;; i = (i + 1) & mask) {
+      auto &e = entries[i];
+      if (e.stamp != generation) {
+        e = Entry{cx, cy, generation, V{}};
+        used += 1;
+        return e.value;
+      }
+      if (e.cx == cx && e.cy == cy) {
+        return e.value;
+      }
+    }
+  }
+};
@@ -0,0 +1,65 @@
+#include "hud.h"
+
+#include <cmath>
+#include <cstdio>
+
+#include "world.h"
+
+// Room for the three lines at FONT_SIZE with raylib's line spacing.
+constexpr int TEXT_W = 640;
+constexpr int TEXT_H = 160;
+constexpr int TEXT_X = 10;
+constexpr int TEXT_Y = 20;
+
+void Hud::load() {
+  target = LoadRenderTexture(TEXT_W, TEXT_H);
+  retained = IsRenderTextureReady(target);
+  game_over_width = MeasureText("GAME OVER", BANNER_SIZE);
+  pause_width = MeasureText("PAUSE", BANNER_SIZE);
+}
+
+void Hud::update(uint64_t frame_counter, uint64_t level, uint64_t experience) {
+  auto seconds = frame_counter / 60;
+  if (seconds == this->seconds && level == this->level &&
+      experience == this->experience) {
+    return;
+  }
+  if (level != this->level) {
+    threshold = std::pow(phi, level);
+  }
+  this->seconds = seconds;
+  this->level = level;
+  this->experience = experience;
+  std::snprintf(text, sizeof(text),
+                "%02llu:%02llu\nLevel: %llu\nXP: %llu",
+                (unsigned long long)(seconds / 60),
+                (unsigned long long)(seconds % 60), (unsigned long long)level,
+                (unsigned long long)experience);
+  if (retained) {
+    BeginTextureMode(target);
+    ClearBackground(BLANK);
+    DrawText(text, 0, 0, FONT_SIZE, WHITE);
+    EndTextureMode();
+  }
+}
+
+void Hud::draw(int w, int h, int bar_width, bool game_over, bool paused) {
+  if (retained) {
+    // Render textures come out upside down.
+    DrawTextureRec(target.texture,
+                   Rectangle{0, 0, float(TEXT_W), -float(TEXT_H)},
+                   Vector2{float(TEXT_X), float(TEXT_Y)}, WHITE);
+  } else {
+    DrawText(text, TEXT_X, TEXT_Y, FONT_SIZE, WHITE);
+  }
+  int wc = (experience - threshold) / threshold * bar_width;
+  DrawRectangle(0, 0, wc, 10, SKYBLUE);
+  DrawRectangle(wc, 0, bar_width - wc, 10, BLUE);
+  if (game_over) {
+    DrawText("GAME OVER", (w - game_over_width) / 2, h / 2 - 36, BANNER_SIZE,
+             BLACK);
+  }
+  if (paused) {
+    DrawText("PAUSE", (w - pause_width) / 2, h / 2 - 36, BANNER_SIZE, BLACK);
+  }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+#include "raylib.h"
+
+// The timer, level and XP block in the corner of the screen, kept in a
+// render texture that is only redrawn when one of the values it shows
+// changes, which is about once a second. Text is formatted into a fixed
+// buffer, the XP threshold of the current level and the widths of the
+// banners are computed once, so an unchanged frame costs one textured quad
+// and a few rectangles.
+struct Hud {
+  static constexpr int FONT_SIZE = 30;
+  static constexpr int BANNER_SIZE = 72;
+
+  // Needs the window to be open.
+  void load();
+
+  // Redraws the text block if the values differ from the last call. Call it
+  // before BeginDrawing, switching render targets mid-frame flushes the
+  // batch.
+  void update(uint64_t frame_counter, uint64_t level, uint64_t experience);
+
+  // Draws the text block, the XP bar across `bar_width` and the game over or
+  // pause banner on a `w` x `h` screen.
+  void draw(int w, int h, int bar_width, bool game_over, bool paused);
+
+private:
+  // What the texture currently shows.
+  uint64_t seconds = ~uint64_t(0);
+  uint64_t level = ~uint64_t(0);
+  uint64_t experience = ~uint64_t(0);
+  // phi^level, the experience the current level started at.
+  double threshold = 1;
+  RenderTexture2D target{};
+  bool retained = false;
+  char text[96] = {};
+  int game_over_width = 0;
+  int pause_width = 0;
+};
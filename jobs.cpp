@@ -0,0 +1,106 @@
+#include "jobs.h"
+
+// How often an idle worker polls for the next batch before going to sleep.
+// Passes of one tick come in quick succession, waking through the condition
+// variable for each of them would cost more than the pass itself.
+constexpr int SPIN_ROUNDS = 4096;
+
+JobSystem::JobSystem(int threads) {
+  threads = std::max(1, threads);
+  queues = std::make_unique<Queue[]>(threads);
+  for (int id = 1; id < threads; ++id) {
+    workers.emplace_back([this, id] { work(id); });
+  }
+}
+
+JobSystem::~JobSystem() {
+  {
+    std::lock_guard lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto &t : workers) {
+    t.join();
+  }
+}
+
+void JobSystem::run(const Batch &b, int count) {
+  auto n = threads();
+  auto e = epoch.load(std::memory_order_relaxed) + 1;
+  remaining.store(count, std::memory_order_relaxed);
+  for (int id = 0; id < n; ++id) {
+    std::lock_guard lock(queues[id].mutex);
+    queues[id].epoch = e;
+    queues[id].lo = int(int64_t(count) * id / n);
+    queues[id].hi = int(int64_t(count) * (id + 1) / n);
+  }
+  {
+    std::lock_guard lock(mutex);
+    batch = b;
+    epoch.store(e, std::memory_order_release);
+  }
+  wake.notify_all();
+
+  drain(0, e, b);
+  while (remaining.load(std::memory_order_acquire) > 0) {
+    std::this_thread::yield();
+  }
+}
+
+void JobSystem::work(int id) {
+  uint64_t seen = 0;
+  for (;;) {
+    for (int i = 0; i < SPIN_ROUNDS; ++i) {
+      if (epoch.load(std::memory_order_acquire) != seen) {
+        break;
+      }
+      std::this_thread::yield();
+    }
+    Batch b;
+    {
+      std::unique_lock lock(mutex);
+      wake.wait(lock, [&] {
+        return stopping || epoch.load(std::memory_order_relaxed) != seen;
+      });
+      if (stopping) {
+        return;
+      }
+      seen = epoch.load(std::memory_order_relaxed);
+      b = batch;
+    }
+    drain(id, seen, b);
+  }
+}
+
+void JobSystem::drain(int id, uint64_t e, const Batch &b) {
+  int chunk;
+  while (take(id, e, chunk)) {
+    auto begin = chunk * b.grain;
+    b.call(b.ctx, chunk, begin, std::min(b.n, begin + b.grain));
+    remaining.fetch_sub(1, std::memory_order_release);
+  }
+}
+
+bool JobSystem::take(int id, uint64_t e, int &chunk) {
+  // A worker that wakes up late finds its queues stamped with a newer epoch
+  // and leaves them alone; the caller only returns once every chunk of its
+  // own batch has run, so `batch` stays valid for everyone who matches.
+  auto n = threads();
+  {
+    auto &q = queues[id];
+    std::lock_guard lock(q.mutex);
+    if (q.epoch == e && q.lo < q.hi) {
+      chunk = q.lo++;
+      return true;
+    }
+  }
+  for (int k = 1; k < n; ++k) {
+    auto &q = queues[(id + k) % n];
+    std::lock_guard lock(q.mutex);
+    if (q.epoch == e && q.lo < q.hi) {
+      chunk = --q.hi;
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Small fork-join scheduler for the data-parallel passes of a tick.
+// parallel_for() cuts a range into fixed-size chunks, deals contiguous runs
+// of them out to one queue per thread and works through them on the pool
+// threads and the calling thread together. A thread whose own queue runs dry
+// steals chunks from the far end of another's.
+//
+// Chunk boundaries depend only on `n` and `grain`, never on the number of
+// threads or on who ran what, so a pass that keeps one output buffer per
+// chunk and merges them in chunk order gets the same result on any number of
+// threads.
+struct JobSystem {
+  // `threads` includes the calling thread; 1 runs everything inline.
+  explicit JobSystem(int threads);
+  ~JobSystem();
+  JobSystem(const JobSystem &) = delete;
+  JobSystem &operator=(const JobSystem &) = delete;
+
+  int threads() const { return int(workers.size()) + 1; }
+
+  static int chunks(int n, int grain) { return (n + grain - 1) / grain; }
+
+  // Calls f(chunk, begin, end) for every chunk of [0, n) and returns once
+  // all of them have finished.
+  template <typename F> void parallel_for(int n, int grain, F &&f) {
+    auto count = chunks(n, grain);
+    if (count <= 1 || workers.empty()) {
+      for (int c = 0; c < count; ++c) {
+        f(c, c * grain, std::min(n, (c + 1) * grain));
+      }
+      return;
+    }
+    using Fn = std::remove_reference_t<F>;
+    run(Batch{[](void *ctx, int c, int begin, int end) {
+                (*static_cast<Fn *>(ctx))(c, begin, end);
+              },
+              &f, n, grain},
+        count);
+  }
+
+private:
+  struct Batch {
+    void (*call)(void *ctx, int chunk, int begin, int end) = nullptr;
+    void *ctx = nullptr;
+    int n = 0;
+    int grain = 1;
+  };
+
+  // Chunks [lo, hi) of batch `epoch` still waiting to run. The owner takes
+  // from lo, thieves from hi.
+  struct alignas(64) Queue {
+    std::mutex mutex;
+    uint64_t epoch = 0;
+    int lo = 0;
+    int hi = 0;
+  };
+
+  void run(const Batch &batch, int count);
+  void work(int id);
+  void drain(int id, uint64_t epoch, const Batch &batch);
+  bool take(int id, uint64_t epoch, int &chunk);
+
+  std::vector<std::thread> workers;
+  std::unique_ptr<Queue[]> queues;
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  Batch batch;
+  std::atomic<uint64_t> epoch{0};
+  bool stopping = false;
+  std::atomic<int> remaining{0};
+};
@@ -0,0 +1,262 @@
+#include "kernels.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(VSRO_SCALAR_KERNELS)
+#define KERNELS_SCALAR
+#elif defined(__AVX2__)
+#define KERNELS_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#define KERNELS_SSE2
+#include <emmintrin.h>
+#else
+#define KERNELS_SCALAR
+#endif
+
+// The push of repel() peaks at radius / sqrt(3); this makes the peak
+// about 1.
+static float repel_scale(float radius) {
+  return 2.6f / (radius * radius * radius);
+}
+
+// Every version of repel() adds up its lanes the same way.
+static Vector2 sum_lanes(const float *px, const float *py) {
+  Vector2 sum{0, 0};
+  for (int i = 0; i < KERNEL_WIDTH; ++i) {
+    sum.x += px[i];
+    sum.y += py[i];
+  }
+  return sum;
+}
+
+#if defined(KERNELS_AVX2)
+
+static __m256 live_mask(const uint8_t *alive) {
+  auto bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(alive));
+  auto lanes = _mm256_cvtepu8_epi32(bytes);
+  return _mm256_castsi256_ps(
+      _mm256_cmpgt_epi32(lanes, _mm256_setzero_si256()));
+}
+
+void chase(float *x, float *y, const uint8_t *alive, int n, Vector2 target,
+           float speed) {
+  auto tx = _mm256_set1_ps(target.x);
+  auto ty = _mm256_set1_ps(target.y);
+  auto s = _mm256_set1_ps(speed);
+  auto zero = _mm256_setzero_ps();
+  for (int i = 0; i < n; i += 8) {
+    auto px = _mm256_load_ps(x + i);
+    auto py = _mm256_load_ps(y + i);
+    auto dx = _mm256_sub_ps(tx, px);
+    auto dy = _mm256_sub_ps(ty, py);
+    auto d = _mm256_sqrt_ps(
+        _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+    auto k = _mm256_div_ps(s, d);
+    auto m = _mm256_and_ps(live_mask(alive + i),
+                           _mm256_cmp_ps(d, zero, _CMP_GT_OQ));
+    px = _mm256_blendv_ps(px, _mm256_add_ps(px, _mm256_mul_ps(dx, k)), m);
+    py = _mm256_blendv_ps(py, _mm256_add_ps(py, _mm256_mul_ps(dy, k)), m);
+    _mm256_store_ps(x + i, px);
+    _mm256_store_ps(y + i, py);
+  }
+}
+
+Vector2 repel(Vector2 p, const float *ox, const float *oy, const int *ranges,
+              int count, float radius) {
+  auto x = _mm256_set1_ps(p.x);
+  auto y = _mm256_set1_ps(p.y);
+  auto r2 = _mm256_set1_ps(radius * radius);
+  auto scale = _mm256_set1_ps(repel_scale(radius));
+  auto lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  auto ax = _mm256_setzero_ps();
+  auto ay = _mm256_setzero_ps();
+  for (int r = 0; r < count; ++r) {
+    auto end = ranges[2 * r + 1];
+    for (int j = ranges[2 * r]; j < end; j += 8) {
+      auto dx = _mm256_sub_ps(x, _mm256_loadu_ps(ox + j));
+      auto dy = _mm256_sub_ps(y, _mm256_loadu_ps(oy + j));
+      auto d2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+      auto inside = _mm256_castsi256_ps(
+          _mm256_cmpgt_epi32(_mm256_set1_epi32(end - j), lane));
+      auto near = _mm256_and_ps(inside, _mm256_cmp_ps(d2, r2, _CMP_LT_OQ));
+      auto k = _mm256_mul_ps(_mm256_sub_ps(r2, d2), scale);
+      ax = _mm256_blendv_ps(ax, _mm256_add_ps(ax, _mm256_mul_ps(dx, k)), near);
+      ay = _mm256_blendv_ps(ay, _mm256_add_ps(ay, _mm256_mul_ps(dy, k)), near);
+    }
+  }
+  alignas(32) float px[8];
+  alignas(32) float py[8];
+  _mm256_store_ps(px, ax);
+  _mm256_store_ps(py, ay);
+  return sum_lanes(px, py);
+}
+
+int within(const float *x, const float *y, const uint8_t *alive, int n,
+           Vector2 center, float radius, int *out) {
+  auto cx = _mm256_set1_ps(center.x);
+  auto cy = _mm256_set1_ps(center.y);
+  auto r2 = _mm256_set1_ps(radius * radius);
+  int count = 0;
+  for (int i = 0; i < n; i += 8) {
+    auto dx = _mm256_sub_ps(cx, _mm256_load_ps(x + i));
+    auto dy = _mm256_sub_ps(cy, _mm256_load_ps(y + i));
+    auto d2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+    auto m = _mm256_and_ps(live_mask(alive + i),
+                           _mm256_cmp_ps(d2, r2, _CMP_LE_OQ));
+    unsigned bits = _mm256_movemask_ps(m);
+    while (bits) {
+      out[count++] = i + __builtin_ctz(bits);
+      bits &= bits - 1;
+    }
+  }
+  return count;
+}
+
+#elif defined(KERNELS_SSE2)
+
+static __m128 live_mask(const uint8_t *alive) {
+  int32_t bytes;
+  std::memcpy(&bytes, alive, sizeof(bytes));
+  auto zero = _mm_setzero_si128();
+  auto lanes = _mm_unpacklo_epi16(
+      _mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero);
+  return _mm_castsi128_ps(_mm_cmpgt_epi32(lanes, zero));
+}
+
+static __m128 select(__m128 m, __m128 a, __m128 b) {
+  return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+}
+
+void chase(float *x, float *y, const uint8_t *alive, int n, Vector2 target,
+           float speed) {
+  auto tx = _mm_set1_ps(target.x);
+  auto ty = _mm_set1_ps(target.y);
+  auto s = _mm_set1_ps(speed);
+  auto zero = _mm_setzero_ps();
+  for (int i = 0; i < n; i += 4) {
+    auto px = _mm_load_ps(x + i);
+    auto py = _mm_load_ps(y + i);
+    auto dx = _mm_sub_ps(tx, px);
+    auto dy = _mm_sub_ps(ty, py);
+    auto d = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+    auto k = _mm_div_ps(s, d);
+    auto m = _mm_and_ps(live_mask(alive + i), _mm_cmpgt_ps(d, zero));
+    px = select(m, _mm_add_ps(px, _mm_mul_ps(dx, k)), px);
+    py = select(m, _mm_add_ps(py, _mm_mul_ps(dy, k)), py);
+    _mm_store_ps(x + i, px);
+    _mm_store_ps(y + i, py);
+  }
+}
+
+// Lanes 0-3 and 4-7 of a KERNEL_WIDTH block go to two registers.
+Vector2 repel(Vector2 p, const float *ox, const float *oy, const int *ranges,
+              int count, float radius) {
+  auto x = _mm_set1_ps(p.x);
+  auto y = _mm_set1_ps(p.y);
+  auto r2 = _mm_set1_ps(radius * radius);
+  auto scale = _mm_set1_ps(repel_scale(radius));
+  auto lane = _mm_setr_epi32(0, 1, 2, 3);
+  __m128 ax[2] = {_mm_setzero_ps(), _mm_setzero_ps()};
+  __m128 ay[2] = {_mm_setzero_ps(), _mm_setzero_ps()};
+  for (int r = 0; r < count; ++r) {
+    auto end = ranges[2 * r + 1];
+    for (int j = ranges[2 * r]; j < end; j += 8) {
+      for (int h = 0; h < 2; ++h) {
+        auto dx = _mm_sub_ps(x, _mm_loadu_ps(ox + j + 4 * h));
+        auto dy = _mm_sub_ps(y, _mm_loadu_ps(oy + j + 4 * h));
+        auto d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+        auto inside = _mm_castsi128_ps(
+            _mm_cmpgt_epi32(_mm_set1_epi32(end - j - 4 * h), lane));
+        auto near = _mm_and_ps(inside, _mm_cmplt_ps(d2, r2));
+        auto k = _mm_mul_ps(_mm_sub_ps(r2, d2), scale);
+        ax[h] = select(near, _mm_add_ps(ax[h], _mm_mul_ps(dx, k)), ax[h]);
+        ay[h] = select(near, _mm_add_ps(ay[h], _mm_mul_ps(dy, k)), ay[h]);
+      }
+    }
+  }
+  alignas(16) float px[8];
+  alignas(16) float py[8];
+  _mm_store_ps(px, ax[0]);
+  _mm_store_ps(px + 4, ax[1]);
+  _mm_store_ps(py, ay[0]);
+  _mm_store_ps(py + 4, ay[1]);
+  return sum_lanes(px, py);
+}
+
+int within(const float *x, const float *y, const uint8_t *alive, int n,
+           Vector2 center, float radius, int *out) {
+  auto cx = _mm_set1_ps(center.x);
+  auto cy = _mm_set1_ps(center.y);
+  auto r2 = _mm_set1_ps(radius * radius);
+  int count = 0;
+  for (int i = 0; i < n; i += 4) {
+    auto dx = _mm_sub_ps(cx, _mm_load_ps(x + i));
+    auto dy = _mm_sub_ps(cy, _mm_load_ps(y + i));
+    auto d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+    auto m = _mm_and_ps(live_mask(alive + i), _mm_cmple_ps(d2, r2));
+    unsigned bits = _mm_movemask_ps(m);
+    while (bits) {
+      out[count++] = i + __builtin_ctz(bits);
+      bits &= bits - 1;
+    }
+  }
+  return count;
+}
+
+#else
+
+void chase(float *x, float *y, const uint8_t *alive, int n, Vector2 target,
+           float speed) {
+  for (int i = 0; i < n; ++i) {
+    if (alive[i]) {
+      auto dx = target.x - x[i];
+      auto dy = target.y - y[i];
+      auto d = std::sqrt(dx * dx + dy * dy);
+      if (d > 0) {
+        auto k = speed / d;
+        x[i] += dx * k;
+        y[i] += dy * k;
+      }
+    }
+  }
+}
+
+Vector2 repel(Vector2 p, const float *ox, const float *oy, const int *ranges,
+              int count, float radius) {
+  auto r2 = radius * radius;
+  auto scale = repel_scale(radius);
+  float px[KERNEL_WIDTH] = {};
+  float py[KERNEL_WIDTH] = {};
+  for (int r = 0; r < count; ++r) {
+    auto begin = ranges[2 * r];
+    for (int j = begin; j < ranges[2 * r + 1]; ++j) {
+      auto dx = p.x - ox[j];
+      auto dy = p.y - oy[j];
+      auto d2 = dx * dx + dy * dy;
+      if (d2 < r2) {
+        auto k = (r2 - d2) * scale;
+        px[(j - begin) % KERNEL_WIDTH] += dx * k;
+        py[(j - begin) % KERNEL_WIDTH] += dy * k;
+      }
+    }
+  }
+  return sum_lanes(px, py);
+}
+
+int within(const float *x, const float *y, const uint8_t *alive, int n,
+           Vector2 center, float radius, int *out) {
+  auto r2 = radius * radius;
+  int count = 0;
+  for (int i = 0; i < n; ++i) {
+    auto dx = center.x - x[i];
+    auto dy = center.y - y[i];
+    if (alive[i] && dx * dx + dy * dy <= r2) {
+      out[count++] = i;
+    }
+  }
+  return count;
+}
+
+#endif
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+#include "raylib.h"
+
+// Batch kernels over structure-of-arrays columns. Each has an AVX2, an SSE2
+// and a scalar version picked at compile time; all of them do the same float
+// operations in the same order, so they produce identical results.
+//
+// The vector versions work in whole lanes, `n` is rounded up to a multiple
+// of KERNEL_WIDTH and the columns must be allocated at least that long.
+
+constexpr int KERNEL_WIDTH = 8;
+
+// Moves every live point `speed` units towards `target`.
+void chase(float *x, float *y, const uint8_t *alive, int n, Vector2 target,
+           float speed);
+
+// Push on `p` away from the points (ox[j], oy[j]) closer than `radius`, for
+// j in each of the `count` ranges [ranges[2r], ranges[2r + 1]). The push of
+// one point grows from 0 at no distance to about 1 at a bit over half the
+// radius and falls back to 0 at `radius`; it takes no square root or
+// division. Point j of a range goes to lane (j - begin) % KERNEL_WIDTH and
+// the lanes are summed at the end, so every version adds the same terms in
+// the same order. ox and oy need KERNEL_WIDTH readable entries past the end
+// of every range and need not be aligned.
+Vector2 repel(Vector2 p, const float *ox, const float *oy, const int *ranges,
+              int count, float radius);
+
+// Writes the indices of live points within `radius` of `center` to `out`,
+// in ascending order, and returns how many there are.
+int within(const float *x, const float *y, const uint8_t *alive, int n,
+           Vector2 center, float radius, int *out);
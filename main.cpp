@@ -1,97 +1,142 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
 
 #include <fmt/format.h>
 
 #include "raylib.h"
 #include "raymath.h"
 
-constexpr int RECT_NUMBER = 4096;
-constexpr int ENOUGH = 4096;
-constexpr double phi = 1.61803398875;
-
-struct Enemy {
-  Vector2 pos{0, 0};
-  int hp = 0;
-  int init_hp = 0;
-  bool alive = false;
-};
-
-struct Bullet {
-  Vector2 pos{0, 0};
-  Vector2 dv{0, 0};
-  int typ = 0;
-  int lifetime = 0;
-  int damage = 0;
-  int close_encounters[10] = {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1};
-  bool alive = false;
-};
-
-struct Rocket {
-  Vector2 pos{0, 0};
-  Vector2 dv{0, 0};
-  bool alive = false;
-};
-
-struct Experience {
-  Vector2 pos{0, 0};
-  int value = 0;
-  int typ = 0;
-  bool alive = false;
-};
-
-struct Item {
-  Vector2 pos{0, 0};
-  int typ = 0;
-  bool alive = false;
-};
+#include "allocs.h"
+#include "atlas.h"
+#include "background.h"
+#include "batch.h"
+#include "checkpoint.h"
+#include "governor.h"
+#include "hud.h"
+#include "jobs.h"
+#include "profiler.h"
+#include "render.h"
+#include "replay.h"
+#include "sim.h"
+#include "world.h"
 
-struct Boss {
-  Vector2 pos{0, 0};
-  int hp = 1000000;
-  bool alive = false;
-};
-
-template <typename T> int find_dead(T array[], int len, int start) {
-  if (start == -1) {
-    start = 0;
-  }
-  auto old = start;
-  do {
-    start = (start + 1) % len;
-    if (!array[start].alive) {
-      break;
+constexpr int RECT_NUMBER = 4096;
+constexpr uint64_t PROFILE_WINDOW = 2'000'000'000;
+
+// Usage: VSRO [--record FILE | --replay FILE] [--checksum-every N]
+//             [--capacity N] [--tiles N] [--load FILE] [--checkpoint FILE]
+//             [--profile-csv FILE] [--profile-trace FILE]
+//             [--alloc-check WARMUP]
+//   --record    write the seed and every tick's input to FILE on exit.
+//   --replay    play FILE back as fast as possible instead of taking input,
+//               then print per-phase timings and the world checksums.
+//   --capacity  how many entities each pool holds (default ENOUGH). A
+//               replay uses the capacity it was recorded with.
+//   --tiles     how many background rectangles to scatter.
+//   --load      start from a checkpoint instead of a new world.
+//   --checkpoint  where F5 saves a checkpoint (default checkpoint.vsck).
+//   --profile-csv, --profile-trace  write the zones still in the profiler
+//               ring on exit as CSV or as a Chrome trace.
+//   --alloc-check  quit with an error once a frame after the first WARMUP
+//               frames, or a tick after the first WARMUP ticks, allocates
+//               on the heap. With glibc, the stack of every such allocation
+//               is printed too.
+//
+// F3 shows draw statistics and the frame governor's quality level, F4 the
+// profiler overlay: p50/p99 of every zone over the last PROFILE_WINDOW and
+// the live entities in each pool.
+// F5 saves a checkpoint between two ticks.
+int main(int argc, char *argv[]) {
+  const char *record_path = nullptr;
+  const char *replay_path = nullptr;
+  int checksum_every = 0;
+  int capacity = ENOUGH;
+  int tiles = RECT_NUMBER;
+  const char *csv_path = nullptr;
+  const char *trace_path = nullptr;
+  const char *load_path = nullptr;
+  const char *checkpoint_path = "checkpoint.vsck";
+  int alloc_warmup = -1;
+  for (int i = 1; i < argc; ++i) {
+    if (!std::strcmp(argv[i], "--record") && i + 1 < argc) {
+      record_path = argv[++i];
+    } else if (!std::strcmp(argv[i], "--replay") && i + 1 < argc) {
+      replay_path = argv[++i];
+    } else if (!std::strcmp(argv[i], "--checksum-every") && i + 1 < argc) {
+      checksum_every = std::atoi(argv[++i]);
+    } else if (!std::strcmp(argv[i], "--capacity") && i + 1 < argc) {
+      capacity = std::max(1, std::atoi(argv[++i]));
+    } else if (!std::strcmp(argv[i], "--tiles") && i + 1 < argc) {
+      tiles = std::max(0, std::atoi(argv[++i]));
+    } else if (!std::strcmp(argv[i], "--profile-csv") && i + 1 < argc) {
+      csv_path = argv[++i];
+    } else if (!std::strcmp(argv[i], "--profile-trace") && i + 1 < argc) {
+      trace_path = argv[++i];
+    } else if (!std::strcmp(argv[i], "--load") && i + 1 < argc) {
+      load_path = argv[++i];
+    } else if (!std::strcmp(argv[i], "--checkpoint") && i + 1 < argc) {
+      checkpoint_path = argv[++i];
+    } else if (!std::strcmp(argv[i], "--alloc-check") && i + 1 < argc) {
+      alloc_warmup = std::max(0, std::atoi(argv[++i]));
+    } else {
+      fmt::print(stderr, "unknown argument: {}\n", argv[i]);
+      return 1;
     }
-  } while (start != old);
-  if (old == start) {
-    start = -1;
   }
-  return start;
-}
 
-int main(int argc, char *argv[]) {
-  SetRandomSeed(time(NULL));
-  auto win_w = 1000;
-  auto win_h = 1000;
-  auto fps = 60;
+  if (load_path && (record_path || replay_path)) {
+    fmt::print(stderr, "--load can't be combined with --record or --replay\n");
+    return 1;
+  }
 
-  auto inside_the_field = [=](Vector2 p, Enemy e) {
-    return e.pos.x > p.x - win_w / 2 && e.pos.y > p.y - win_h / 2 &&
-           e.pos.x < p.x + win_w / 2 && e.pos.y < p.y + win_h / 2;
-  };
+  Recording recording;
+  recording.seed = time(NULL);
+  recording.capacity = capacity;
+  if (replay_path && !recording.load(replay_path)) {
+    fmt::print(stderr, "can't read recording {}\n", replay_path);
+    return 1;
+  }
+
+  SetRandomSeed(recording.seed);
+  auto win_w = replay_path ? recording.view_w : 1000;
+  auto win_h = replay_path ? recording.view_h : 1000;
 
   InitWindow(win_w, win_h, "VSRO");
 
-  Rectangle rectangles[RECT_NUMBER];
-  Color rect_colors[RECT_NUMBER];
-  Enemy enemies[ENOUGH];
-  Bullet bullets[ENOUGH];
-  Experience experiences[ENOUGH];
-  Item items[ENOUGH];
-  Rocket rocket;
-  Boss boss;
-  int rocket_exploded = 0;
-  bool rocket_target_locked = false;
-  int rocket_target_idx = 0;
+  std::vector<Rectangle> rectangles(tiles);
+  std::vector<Color> rect_colors(tiles);
+  JobSystem jobs(std::thread::hardware_concurrency());
+  PhaseTimes phase_times;
+  Profiler profiler;
+  auto world = load_path
+                   ? load_checkpoint(load_path)
+                   : std::make_unique<World>(recording.seed, recording.capacity);
+  if (!world) {
+    fmt::print(stderr, "can't read checkpoint {}\n", load_path);
+    CloseWindow();
+    return 1;
+  }
+  auto pool_capacity = world->capacity();
+  world->jobs = &jobs;
+  world->timing = &phase_times;
+  world->profiler = &profiler;
+  Simulation::Options options;
+  if (replay_path) {
+    options.replay = &recording;
+  } else if (record_path) {
+    recording.view_w = GetScreenWidth();
+    recording.view_h = GetScreenHeight();
+    options.record = &recording;
+  }
+  options.checksum_every = checksum_every;
+  options.checkpoint_path = checkpoint_path;
+  options.alloc_warmup = alloc_warmup;
+  Simulation sim(std::move(world), options);
 
   for (auto &rect : rectangles) {
     auto x = float(GetRandomValue(-10000, 10000));
@@ -104,592 +149,277 @@ int main(int argc, char *argv[]) {
     color = Color{0, uint8_t(128 + GetRandomValue(-64, 64)), 0, 255};
   }
 
-  Vector2 player{720, 400};
-  int player_hp = 1000;
-  int player_speed = 2;
-  uint64_t player_experience = 0;
-  uint64_t player_level = 0;
+  BackgroundCache background;
+  background.load(rectangles.data(), rect_colors.data(), tiles,
+                  Rectangle{-10000, -10000, 20000, 20000});
+
   Camera2D camera = {0};
-  camera.target = Vector2{player.x, player.y};
+  camera.target = sim.current().player;
   camera.offset = Vector2{GetScreenWidth() / 2.0f, GetScreenHeight() / 2.0f};
   camera.rotation = 0;
   camera.zoom = 1;
 
+  // The simulation ticks on its own thread, so drawing can keep up with
+  // whatever the display does.
+  auto fps = GetMonitorRefreshRate(GetCurrentMonitor());
+  fps = fps > 0 ? fps : 60;
   SetTargetFPS(fps);
-  uint64_t frame_counter = 0;
-  int dead_enemy = 0;
-  int dead_bullet = 0;
-  int dead_experience = 0;
-  int dead_item = 0;
-
-  auto drop_xp = [&](Enemy &e) {
-    if (dead_experience < 0) {
-      dead_experience = find_dead(experiences, ENOUGH, dead_experience);
-    }
-    if (dead_experience >= 0) {
-      auto &experience = experiences[dead_experience];
-      experience.alive = true;
-      experience.pos = e.pos;
-      experience.value = e.init_hp / 10;
-      experience.typ = 0;
-    } else {
-      experiences[0].value += e.init_hp / 10;
-      experiences[0].typ = 1;
-    }
-    dead_experience = find_dead(experiences, ENOUGH, dead_experience);
-  };
-
-  bool game_over = false;
-  bool pause = true;
-
-  auto morda_r = LoadTexture("morda_r.png");
-  auto morda_l = LoadTexture("morda_l.png");
-  auto morda_o = LoadTexture("morda_o.png");
-  auto boss_texture = LoadTexture("boss.png");
-  auto enemy_texture = LoadTexture("enemy.png");
-  int player_dir = 0;
-  int player_launches = 0;
-  if (!IsTextureReady(morda_o) || !IsTextureReady(morda_l) ||
-      !IsTextureReady(morda_r)) {
-    player_dir = -1;
-  }
+  // Lowers the drawing detail when frames don't fit the budget.
+  Governor governor(fps);
+  bool pause = !replay_path;
+  sim.set_paused(pause);
+  bool show_stats = false;
+  Hud hud;
+  hud.load();
+  bool show_profile = false;
+  Profiler::Stats zone_stats[ZONE_COUNT];
+  std::vector<Profiler::Sample> profile_scratch;
+  // Sorting the ring for F4 then never allocates.
+  profile_scratch.reserve(Profiler::CAPACITY);
+  uint64_t frames_drawn = 0;
+  // Of the last frame: what the render thread allocated, what the ticks
+  // published during it did, and everything any thread did.
+  AllocCount frame_allocs;
+  AllocCount tick_allocs;
+  AllocCount all_allocs;
+  bool alloc_failed = false;
+  SpriteBatch batch;
+  RlglBackend rlgl_backend;
+
+  Atlas atlas;
+  atlas.load();
+  bool player_sprites = atlas.has(SPRITE_MORDA_O) &&
+                        atlas.has(SPRITE_MORDA_L) && atlas.has(SPRITE_MORDA_R);
+  auto enemy_texture = atlas.has(SPRITE_ENEMY) ? atlas.texture : Texture2D{};
+  reserve_entities(batch, enemy_texture, pool_capacity);
 
   while (!WindowShouldClose()) {
+    auto frame_start = Profiler::now();
+    auto allocs_start = thread_allocations();
+    auto ticks_start = sim.tick_allocations();
+    auto all_start = total_allocations();
+    if (alloc_warmup >= 0 && frames_drawn == uint64_t(alloc_warmup)) {
+      trace_allocations(true);
+    }
+    auto mark = frame_start;
+    // Charges the time since the last lap to `zone`.
+    auto lap = [&](Zone zone) {
+      auto now = Profiler::now();
+      profiler.record(zone, mark, now);
+      mark = now;
+    };
     auto w = GetScreenWidth();
     auto h = GetScreenHeight();
 
-    if (!game_over && !pause) {
-      player_speed = 2 + player_level;
-      int freq = 30 - 30 * ((frame_counter % 3600) / 3600.0);
-      if (frame_counter % std::max(1, freq) == 0) {
-        for (int i = 0; i < player_level + 1; ++i) {
-          if (dead_enemy < 0) {
-            dead_enemy = find_dead(enemies, ENOUGH, dead_enemy);
-          }
-          if (dead_enemy >= 0) {
-            auto &enemy = enemies[dead_enemy];
-            int dir = GetRandomValue(1, 4);
-            switch (dir) {
-            case 1:
-              enemy.pos.x = player.x - w / 2 - 20;
-              enemy.pos.y = GetRandomValue(player.y - h / 2, player.y + h / 2);
-              break;
-            case 2:
-              enemy.pos.x = player.x + w / 2 + 20;
-              enemy.pos.y = GetRandomValue(player.y - h / 2, player.y + h / 2);
-              break;
-            case 3:
-              enemy.pos.y = player.y - h / 2 - 20;
-              enemy.pos.x = GetRandomValue(player.x - w / 2, player.x + w / 2);
-              break;
-            case 4:
-              enemy.pos.y = player.y + h / 2 + 20;
-              enemy.pos.x = GetRandomValue(player.x - w / 2, player.x + w / 2);
-              break;
-            default:
-              break;
-            }
-            enemy.init_hp = GetRandomValue(5, 50);
-            enemy.hp = enemies[dead_enemy].init_hp;
-            enemy.alive = true;
-
-            dead_enemy = find_dead(enemies, ENOUGH, dead_enemy);
-          }
-        }
-      }
-
-      if (frame_counter % (player_level >= 10 ? 1 : (10 - player_level)) == 0) {
-        for (int i = 0; i < player_level + 1; ++i) {
-          if (dead_bullet < 0) {
-            dead_bullet = find_dead(bullets, ENOUGH, dead_bullet);
-          }
-          if (dead_bullet >= 0) {
-            auto &bullet = bullets[dead_bullet];
-            bullet.pos = player;
-            bullet.dv.x = GetRandomValue(-10, 10);
-            bullet.dv.y = GetRandomValue(-10, 10);
-            bullet.typ = GetRandomValue(1, 4);
-            if (bullet.typ == 4) {
-              if (GetRandomValue(0, 1)) {
-                bullet.pos.x += (-1 * GetRandomValue(-1, 1)) * 64;
-                bullet.dv.x = 0;
-              } else {
-                bullet.pos.y += (-1 * GetRandomValue(-1, 1)) * 64;
-                bullet.dv.y = 0;
-              }
-            }
-            switch (bullet.typ) {
-            case 1:
-              bullet.damage = 10;
-              break;
-            case 2:
-              bullet.damage = 50;
-              break;
-            case 3:
-              bullet.damage = 20;
-              break;
-            case 4:
-              bullet.damage = 15;
-              break;
-            default:
-              break;
-            }
-            bullet.alive = true;
-            bullet.lifetime = bullet.typ == 3 ? 3 : 1;
-            dead_bullet = find_dead(bullets, ENOUGH, dead_bullet);
-          }
-        }
-      }
-
-      if (frame_counter % (1200 / (player_level + 1)) == 0) {
-        if (!rocket.alive) {
-          rocket.pos = player;
-          rocket.dv = Vector2{(float)GetRandomValue(-10, 10),
-                              (float)GetRandomValue(-10, 10)};
-          rocket.alive = true;
-          if (player_dir >= 0) {
-            player_launches = 30;
-          }
-        }
-      }
-
-      if (frame_counter % 600 == 0) {
-        if (dead_item < 0) {
-          dead_item = find_dead(items, ENOUGH, dead_item);
-        }
-        if (dead_item >= 0) {
-          auto &item = items[dead_item];
-          item.pos = Vector2{(float)GetRandomValue(-10000, 10000),
-                             (float)GetRandomValue(-10000, 10000)};
-          item.typ = 1;
-          item.alive = true;
-          dead_item = find_dead(items, ENOUGH, dead_item);
-        }
-      }
-
-      if (!boss.alive && (frame_counter % (60 * 60 * 10) == 0)) {
-        boss.alive = true;
-        boss.hp = 1000000;
-        boss.pos = Vector2{10000, 10000};
-      }
-
-      for (auto &e : enemies) {
-        if (e.alive) {
-          auto d = Vector2Distance(player, e.pos);
-          if (CheckCollisionCircles(Vector2{player.x, player.y}, 32, e.pos,
-                                    16)) {
-            player_hp -= 1;
-            if (player_hp <= 0) {
-              game_over = true;
-            }
-          }
-          auto dx =
-              std::max(1.0, player_level / 3.0) * (player.x - e.pos.x) / d;
-          auto dy =
-              std::max(1.0, player_level / 3.0) * (player.y - e.pos.y) / d;
-          e.pos.x += dx;
-          e.pos.y += dy;
-        }
-      }
-
-      for (auto &e : experiences) {
-        if (e.alive) {
-          auto d = Vector2Distance(player, e.pos);
-          if (CheckCollisionCircles(player, 32 + pow(1.3, player_level), e.pos,
-                                    8)) {
-            player_experience += e.value;
-            e.alive = false;
-            if (player_experience >= pow(phi, player_level)) {
-              player_level = log2(player_experience) / log2(phi);
-            }
-          }
-        }
-      }
-
-      for (auto &i : items) {
-        if (i.alive) {
-          auto d = Vector2Distance(player, i.pos);
-          if (CheckCollisionCircles(player, 32, i.pos, 16)) {
-            for (auto &e : experiences) {
-              if (e.alive) {
-                player_experience += e.value;
-                e.alive = false;
-                if (player_experience >= pow(phi, player_level)) {
-                  player_level = log2(player_experience) / log2(phi);
-                }
-              }
-            }
-            i.alive = false;
-          }
-        }
-      }
-
-      for (auto &b : bullets) {
-        if (b.alive && boss.alive) {
-          if (CheckCollisionPointCircle(b.pos, boss.pos, 64)) {
-            boss.hp -= b.damage;
-            b.lifetime -= 1;
-            if (b.lifetime <= 0) {
-              b.alive = false;
-            }
-            if (boss.hp <= 0) {
-              boss.alive = false;
-            } else {
-              boss.pos = Vector2Add(
-                  boss.pos,
-                  Vector2Scale(Vector2Subtract(player, boss.pos), -0.001));
-            }
-          }
-        }
-        if (b.alive) {
-          bool found_close = false;
-          auto min_d = std::numeric_limits<float>::max();
-          auto min_idx = 0;
-          auto counter = 0;
-          auto encounter_counter = 0;
-          for (auto e : b.close_encounters) {
-            if (e > 0 && enemies[e].alive) {
-              if (CheckCollisionPointCircle(b.pos, enemies[e].pos, 16)) {
-                b.lifetime -= 1;
-                if (b.lifetime <= 0) {
-                  b.alive = false;
-                }
-                enemies[e].hp -= b.damage;
-                if (enemies[e].hp <= 0) {
-                  enemies[e].alive = false;
-                  drop_xp(enemies[e]);
-                } else {
-                  enemies[e].pos =
-                      Vector2Add(enemies[e].pos, Vector2Scale(b.dv, -1.0));
-                }
-                break;
-              }
-              if (b.alive) {
-                min_d = Vector2Distance(b.pos, enemies[e].pos);
-                min_idx = e;
-                found_close = true;
-                break;
-              }
-            }
-          }
-          if (!found_close) {
-            for (auto &e : enemies) {
-              if (e.alive) {
-                if (CheckCollisionPointCircle(b.pos, e.pos, 16)) {
-                  b.lifetime -= 1;
-                  if (b.lifetime <= 0) {
-                    b.alive = false;
-                  }
-                  e.hp -= b.damage;
-                  if (e.hp <= 0) {
-                    e.alive = false;
-                    drop_xp(e);
-                  } else {
-                    e.pos = Vector2Add(e.pos, Vector2Scale(b.dv, -1.0));
-                  }
-                  break;
-                } else if (b.typ == 2 || b.typ == 3) {
-                  auto d = Vector2Distance(e.pos, b.pos);
-                  if (d < min_d && inside_the_field(player, e)) {
-                    min_d = d;
-                    min_idx = counter;
-                    b.close_encounters[encounter_counter] = counter;
-                    encounter_counter = (encounter_counter + 1) % 10;
-                  }
-                } else if (b.typ == 4) {
-                  auto d = Vector2Distance(player, b.pos);
-                  auto dx = (player.x - b.pos.x) / d;
-                  auto dy = (player.y - b.pos.y) / d;
-                  if (d > 128) {
-                    b.dv.x = (-10 * dy + 0.1 * dx) / 2;
-                    b.dv.y = (10 * dx + 0.1 * dy) / 2;
-                  } else if (d < 128) {
-                    b.dv.x = (-10 * dy - 0.1 * dx) / 2;
-                    b.dv.y = (10 * dx - 0.1 * dy) / 2;
-                  }
-                  b.dv.x = std::min(10.0f, b.dv.x);
-                  b.dv.y = std::min(10.0f, b.dv.y);
-                }
-              }
-              counter += 1;
-            }
-          }
-          if (b.alive) {
-            if (b.typ == 2) {
-              auto dx = 3 * (enemies[min_idx].pos.x - b.pos.x) / min_d;
-              auto dy = 3 * (enemies[min_idx].pos.y - b.pos.y) / min_d;
-              b.dv.x += 0.1 * dx;
-              b.dv.y += 0.1 * dy;
-            }
-            if (b.typ == 3) {
-              auto dx = (3 + player_level * 0.1f) *
-                        (enemies[min_idx].pos.x - b.pos.x) / min_d;
-              auto dy = (3 + player_level * 0.1f) *
-                        (enemies[min_idx].pos.y - b.pos.y) / min_d;
-              b.dv = Vector2Scale(Vector2Add(b.dv, Vector2{dx, dy}), 0.5);
-            }
-            b.pos = Vector2Add(b.pos, b.dv);
-            if (Vector2Distance(player, b.pos) > 1000) {
-              b.alive = false;
-            }
-          }
-        }
-      }
+    sim.update();
+    auto &prev = sim.previous();
+    auto &snap = sim.current();
+    auto alpha = sim.alpha();
+    auto player = interpolate(prev.player, snap.player, alpha);
+    sim.set_view(w, h);
+
+    if (!snap.game_over && !pause) {
+      Input input;
+      input.left = IsKeyDown(KEY_LEFT);
+      input.right = IsKeyDown(KEY_RIGHT);
+      input.up = IsKeyDown(KEY_UP);
+      input.down = IsKeyDown(KEY_DOWN);
+      sim.set_input(input);
 
-      if (rocket.alive) {
-        if (boss.alive) {
-          if (CheckCollisionPointCircle(rocket.pos, boss.pos, 64)) {
-            boss.hp -= 1000;
-            if (boss.hp <= 0) {
-              boss.alive = false;
-            }
-          }
-        }
-        if (rocket_target_locked && enemies[rocket_target_idx].alive) {
-          if (CheckCollisionPointCircle(rocket.pos,
-                                        enemies[rocket_target_idx].pos, 16)) {
-            for (auto &e1 : enemies) {
-              if (e1.alive) {
-                if (Vector2Distance(rocket.pos, e1.pos) <= 500) {
-                  e1.alive = false;
-                  drop_xp(e1);
-                }
-              }
-            }
-            rocket.alive = false;
-            rocket_target_locked = false;
-            rocket_exploded = 6;
-          }
-          if (rocket.alive && enemies[rocket_target_idx].alive) {
-            auto d =
-                Vector2Distance(rocket.pos, enemies[rocket_target_idx].pos);
-            auto dx = (player_level + 5) *
-                      (enemies[rocket_target_idx].pos.x - rocket.pos.x) / d;
-            auto dy = (player_level + 5) *
-                      (enemies[rocket_target_idx].pos.y - rocket.pos.y) / d;
-            rocket.dv = Vector2Clamp(
-                Vector2Scale(Vector2Add(rocket.dv, Vector2{dx, dy}), 0.5),
-                Vector2{-10, -10}, Vector2{10, 10});
-            rocket.pos = Vector2Add(rocket.pos, rocket.dv);
-          }
-        } else {
-          rocket_target_locked = false;
-          auto min_d = std::numeric_limits<float>::max();
-          auto min_idx = 0;
-          auto counter = 0;
-          for (auto &e : enemies) {
-            if (e.alive) {
-              if (CheckCollisionPointCircle(rocket.pos, e.pos, 16)) {
-                for (auto &e1 : enemies) {
-                  if (e1.alive) {
-                    if (Vector2Distance(rocket.pos, e1.pos) <= 500) {
-                      e1.alive = false;
-                      drop_xp(e1);
-                    }
-                  }
-                }
-                rocket.alive = false;
-                rocket_exploded = 6;
-                break;
-              }
-              auto d = Vector2Distance(rocket.pos, e.pos);
-              if (d < min_d) {
-                min_d = d;
-                min_idx = counter;
-              }
-            }
-            counter += 1;
-          }
-          if (rocket.alive) {
-            auto dx = 5 * (enemies[min_idx].pos.x - rocket.pos.x) / min_d;
-            auto dy = 5 * (enemies[min_idx].pos.y - rocket.pos.y) / min_d;
-            rocket.dv = Vector2Clamp(
-                Vector2Scale(Vector2Add(rocket.dv, Vector2{dx, dy}), 0.5),
-                Vector2{-10, -10}, Vector2{10, 10});
-            rocket.pos = Vector2Add(rocket.pos, rocket.dv);
-            rocket_target_locked = true;
-            rocket_target_idx = min_idx;
-          }
-        }
-      }
-
-      if (boss.alive) {
-        auto d = Vector2Distance(player, boss.pos);
-        if (d < 64) {
-          game_over = true;
-        } else {
-          auto dx = (player.x - boss.pos.x) / d;
-          auto dy = (player.y - boss.pos.y) / d;
-          boss.pos.x += ((player_level + 1) / 3) * dx;
-          boss.pos.y += ((player_level + 1) / 3) * dy;
-        }
-      }
-
-      if (IsKeyDown(KEY_LEFT)) {
-        player_dir = 0;
-        player.x -= player_speed;
-      }
-      if (IsKeyDown(KEY_RIGHT)) {
-        player_dir = 1;
-        player.x += player_speed;
-      }
-      if (IsKeyDown(KEY_UP)) {
-        player.y -= player_speed;
-      }
-      if (IsKeyDown(KEY_DOWN)) {
-        player.y += player_speed;
-      }
       auto move = GetMouseWheelMove();
       camera.zoom += 0.05 * move;
       camera.zoom = std::max(0.0f, camera.zoom);
       if (IsMouseButtonDown(MOUSE_BUTTON_MIDDLE)) {
         camera.zoom = 1.0f;
       }
+    }
 
-      if (player.x < -10000) {
-        player.x += 20000;
-      }
-      if (player.x > 10000) {
-        player.x -= 20000;
-      }
-      if (player.y < -10000) {
-        player.y += 20000;
-      }
-      if (player.y > 10000) {
-        player.y -= 20000;
-      }
+    if (IsKeyPressed(KEY_F3)) {
+      show_stats = !show_stats;
+    }
+    if (IsKeyPressed(KEY_F4)) {
+      show_profile = !show_profile;
+    }
+    if (IsKeyPressed(KEY_F5) && !replay_path) {
+      sim.checkpoint();
     }
 
     if (IsKeyPressed(KEY_SPACE)) {
-      if (game_over) {
-        game_over = false;
+      if (snap.game_over) {
+        sim.restart();
         pause = false;
-        frame_counter = 0;
-        player_experience = 0;
-        player_level = 0;
-        player_hp = 1000;
-        for (auto &e : enemies) {
-          e.alive = false;
-        }
-        for (auto &b : bullets) {
-          b.alive = false;
-        }
-        for (auto &e : experiences) {
-          e.alive = false;
-        }
-        rocket.alive = false;
-        player = {0, 0};
       } else {
         pause = !pause;
       }
+      sim.set_paused(pause);
     }
 
     camera.target = Vector2{player.x, player.y};
 
+    hud.update(snap.frame_counter, snap.player_level, snap.player_experience);
+    mark = Profiler::now();
+    background.coarser = governor.background_coarser();
+    background.prepare(camera, w, h);
     BeginDrawing();
     ClearBackground(LIME);
     BeginMode2D(camera);
-    for (int i = 0; i < RECT_NUMBER; ++i) {
-      DrawRectangleRec(rectangles[i], rect_colors[i]);
-    }
-    DrawLineEx({-10000, -10000}, {-10000, 10000}, 5, YELLOW);
-    DrawLineEx({10000, -10000}, {10000, 10000}, 5, YELLOW);
-    DrawLineEx({-10000, -10000}, {10000, -10000}, 5, YELLOW);
-    DrawLineEx({10000, 10000}, {-10000, 10000}, 5, YELLOW);
-    for (int i = 0; i < ENOUGH; ++i) {
-      if (experiences[i].alive) {
-        DrawPoly(experiences[i].pos, 6, 8, 0,
-                 experiences[i].typ ? PINK : SKYBLUE);
-      }
-    }
-    for (int i = 0; i < ENOUGH; ++i) {
-      if (items[i].alive) {
-        DrawPoly(items[i].pos, 4, 16, 0, items[i].typ ? GOLD : GOLD);
-      }
-    }
-    for (int i = 0; i < ENOUGH; ++i) {
-      if (enemies[i].alive) {
-        if (!IsTextureReady(enemy_texture)) {
-          DrawCircleV(enemies[i].pos, 16, RED);
-        } else {
-          DrawTextureV(enemy_texture, enemies[i].pos, WHITE);
-        }
-      }
-    }
-    for (int i = 0; i < ENOUGH; ++i) {
-      if (bullets[i].alive) {
-        if (bullets[i].typ == 2) {
-          DrawPoly(bullets[i].pos, 3, 8,
-                   RAD2DEG * atan2(bullets[i].dv.x, bullets[i].dv.y), WHITE);
-        } else if (bullets[i].typ == 1) {
-          DrawCircleV(bullets[i].pos, 4, WHITE);
-        } else if (bullets[i].typ == 4) {
-          DrawPoly(bullets[i].pos, 6, 8, 0, WHITE);
-        } else {
-          DrawPoly(bullets[i].pos, 4, 8,
-                   RAD2DEG * atan2(bullets[i].dv.x, bullets[i].dv.y), WHITE);
-        }
-      }
-    }
-    if (rocket_exploded) {
+    background.draw(camera, w, h);
+    lap(ZONE_BACKGROUND);
+    batch.reset_stats();
+    draw_entities(prev, snap, alpha, enemy_texture, atlas.rect(SPRITE_ENEMY),
+                  governor.entity_detail(), batch, rlgl_backend);
+    auto rocket = snap.rocket;
+    auto boss = snap.boss;
+    if (snap.rocket_exploded) {
       DrawCircleV(rocket.pos, 500, WHITE);
-      rocket_exploded -= 1;
     }
+    // The boss and the player come from the same atlas as the enemies and
+    // go out in one submission.
+    auto centered = [&](Sprite sprite, Vector2 center) {
+      auto src = atlas.rect(sprite);
+      batch.sprite(atlas.texture, src,
+                   Rectangle{center.x - src.width / 2,
+                             center.y - src.height / 2, src.width,
+                             src.height},
+                   WHITE);
+    };
     if (boss.alive) {
-      if (IsTextureReady(boss_texture)) {
-        DrawTextureV(boss_texture, Vector2Subtract(boss.pos, {64, 64}), WHITE);
+      boss.pos = interpolate(prev.boss.pos, boss.pos, alpha);
+      if (atlas.has(SPRITE_BOSS)) {
+        centered(SPRITE_BOSS, boss.pos);
       } else {
         DrawCircleV(boss.pos, 64, MAROON);
       }
+    }
+    if (player_sprites) {
+      centered(snap.player_launches > 1
+                   ? SPRITE_MORDA_O
+                   : (snap.player_dir ? SPRITE_MORDA_R : SPRITE_MORDA_L),
+               player);
+    } else {
+      DrawCircle(player.x, player.y, 32, BLUE);
+    }
+    batch.flush(rlgl_backend);
+    if (boss.alive) {
       int wg = boss.hp / 1000000.0 * 128;
       int wr = 128 - wg;
       DrawRectangle(boss.pos.x - 64, boss.pos.y - 70, wg, 5, GREEN);
       DrawRectangle(boss.pos.x - 64 + wg, boss.pos.y - 70, wr, 5, RED);
     }
-    if (player_dir >= 0) {
-      DrawTexture(player_launches > 1 ? morda_o : (player_dir ? morda_r : morda_l),
-                  player.x - 32, player.y - 32, WHITE);
-      if (player_launches > 0) {
-        player_launches -= 1;
-      }
-    } else {
-      DrawCircle(player.x, player.y, 32, BLUE);
-    }
-    int wg = player_hp / (1000.0 + 100 * player_level) * 64;
+    auto player_level = snap.player_level;
+    int wg = snap.player_hp / (1000.0 + 100 * player_level) * 64;
     int wr = 64 - wg;
     DrawRectangle(player.x - 32, player.y - 40, wg, 5, GREEN);
     DrawRectangle(player.x - 32 + wg, player.y - 40, wr, 5, RED);
     if (rocket.alive) {
+      if (prev.rocket.alive) {
+        rocket.pos = interpolate(prev.rocket.pos, rocket.pos, alpha);
+      }
       DrawPoly(rocket.pos, 3, 16, RAD2DEG * atan2(rocket.dv.x, rocket.dv.y),
                ORANGE);
-      DrawLineV(rocket.pos, enemies[rocket_target_idx].pos, ORANGE);
+      if (snap.rocket_locked) {
+        DrawLineV(rocket.pos, snap.rocket_target, ORANGE);
+      }
     }
     EndMode2D();
-    DrawText(fmt::format("{:02}:{:02}\nLevel: {}\nXP: {}", frame_counter / 3600,
-                         frame_counter % 3600 / 60, player_level,
-                         player_experience)
-                 .c_str(),
-             10, 20, 30, WHITE);
-    int wc = (player_experience - pow(phi, player_level)) /
-             pow(phi, player_level) * win_w;
-    DrawRectangle(0, 0, wc, 10, SKYBLUE);
-    DrawRectangle(wc, 0, win_w - wc, 10, BLUE);
-    if (game_over) {
-      DrawText("GAME OVER", (w - MeasureText("GAME OVER", 72)) / 2,
-               GetScreenHeight() / 2 - 36, 72, BLACK);
+    lap(ZONE_ENTITIES);
+    hud.draw(w, h, win_w, snap.game_over, pause);
+    if (show_stats) {
+      auto &gov = governor.stats;
+      DrawText(TextFormat("FPS: %d, tick: %.2f ms\n"
+                          "background: level %d, %d chunks, %d baked, "
+                          "%d tiles tested, %d submitted\n"
+                          "entities: %d draw calls, %d vertices\n"
+                          "quality: %s, p90 %.2f of %.2f ms, %d drops, "
+                          "%d raises\n"
+                          "allocations: render %d, sim %d, all %d "
+                          "(%d bytes, %d frees)",
+                          GetFPS(), sim.step_ms(), background.level,
+                          background.drawn, background.baked,
+                          background.tiles_tested, background.tiles_submitted,
+                          batch.draw_calls, batch.vertices,
+                          Governor::LEVEL_NAMES[gov.level], gov.p90_ms,
+                          gov.budget_ms, gov.drops, gov.raises,
+                          int(frame_allocs.count), int(tick_allocs.count),
+                          int(all_allocs.count), int(all_allocs.bytes),
+                          int(all_allocs.frees)),
+               10, h - 130, 20, WHITE);
     }
-    if (pause) {
-      DrawText("PAUSE", (w - MeasureText("PAUSE", 72)) / 2,
-               GetScreenHeight() / 2 - 36, 72, BLACK);
+    if (show_profile) {
+      // Sorting the ring is not free, so the numbers refresh twice a second.
+      if (frames_drawn % 30 == 0) {
+        profiler.stats(profile_scratch, PROFILE_WINDOW, zone_stats);
+      }
+      // The default font is proportional, so every column is placed.
+      auto x = w - 340;
+      auto y = 20;
+      auto row = [&](const char *name, const char *a, const char *b) {
+        DrawText(name, x, y, 20, WHITE);
+        DrawText(a, x + 220 - MeasureText(a, 20), y, 20, WHITE);
+        DrawText(b, x + 320 - MeasureText(b, 20), y, 20, WHITE);
+        y += 20;
+      };
+      DrawRectangle(x - 10, 10, 340, 20 * (ZONE_COUNT + 6) + 10,
+                    Color{0, 0, 0, 160});
+      row("zone", "p50 us", "p99 us");
+      for (int z = 0; z < ZONE_COUNT; ++z) {
+        auto &st = zone_stats[z];
+        row(zone_name(z), TextFormat("%.1f", st.p50_us),
+            TextFormat("%.1f", st.p99_us));
+      }
+      y += 10;
+      row("pool", "live", "capacity");
+      auto pool = [&](const char *name, int count) {
+        row(name, TextFormat("%d", count),
+            TextFormat("%d", pool_capacity));
+      };
+      pool("enemies", snap.enemies.count);
+      pool("bullets", snap.bullets.count);
+      pool("gems", snap.gem_count);
+      pool("items", snap.item_count);
     }
+    lap(ZONE_HUD);
+    // Whatever EndDrawing adds is mostly the wait for the next frame.
+    governor.frame(Profiler::now() - frame_start);
     EndDrawing();
-
-    if (!game_over && !pause) {
-      frame_counter += 1;
-      player_hp = std::min(uint64_t(player_hp + 1), 1000 + 100 * player_level);
+    profiler.record(ZONE_FRAME, frame_start, Profiler::now());
+    frame_allocs = thread_allocations() - allocs_start;
+    tick_allocs = sim.tick_allocations() - ticks_start;
+    all_allocs = total_allocations() - all_start;
+    if (alloc_warmup >= 0 && frames_drawn >= uint64_t(alloc_warmup) &&
+        frame_allocs.count) {
+      fmt::print(stderr, "frame {} allocated {} times ({} bytes)\n",
+                 frames_drawn, frame_allocs.count, frame_allocs.bytes);
+      alloc_failed = true;
+      break;
     }
+    if (sim.allocating_ticks()) {
+      fmt::print(stderr, "{} ticks after the warmup allocated\n",
+                 sim.allocating_ticks());
+      alloc_failed = true;
+      break;
+    }
+    frames_drawn += 1;
   }
+  trace_allocations(false);
 
+  sim.stop();
+  atlas.unload();
   CloseWindow();
-  return 0;
+  if (replay_path) {
+    print_replay_report(sim.checksums(), phase_times);
+    fmt::print("final checksum {:016x}{}\n", sim.final_world().checksum(),
+               sim.finished() ? "" : " (replay not finished)");
+  }
+  if (csv_path && !profiler.write_csv(csv_path)) {
+    fmt::print(stderr, "can't write profile {}\n", csv_path);
+  }
+  if (trace_path && !profiler.write_trace(trace_path)) {
+    fmt::print(stderr, "can't write trace {}\n", trace_path);
+  }
+  if (record_path && !recording.save(record_path)) {
+    fmt::print(stderr, "can't write recording {}\n", record_path);
+    return 1;
+  }
+  return alloc_failed ? 1 : 0;
 }
@@ -0,0 +1,340 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "background.h"
+#include "kernels.h"
+#include "world.h"
+
+// Times each simulation system on its own, on synthetic worlds, and reports
+// the spread over repetitions and the cost per entity.
+// Usage: VSRO_micro [--enemies N] [--bullets N] [--gems N] [--radius R]
+//                   [--tiles N] [--reps N] [--warmup N] [--seed S]
+//                   [--filter TEXT]
+//   --enemies, --bullets, --gems  population of the synthetic worlds.
+//   --radius  entities are scattered uniformly over a disk of this radius
+//             around the player, which sets their density (default 1000).
+//   --tiles  background rectangles for the culling case.
+//   --reps  timed repetitions per case, after --warmup untimed ones.
+//   --filter  only run cases whose name contains TEXT.
+//
+// Cases that go through World::step are timed with its phase clock, so they
+// measure exactly one phase on a world that was set up fresh for the
+// repetition; the rest call the system directly.
+
+using Clock = std::chrono::steady_clock;
+
+struct Config {
+  int enemies = 4000;
+  int bullets = 2000;
+  int gems = 4000;
+  float radius = 1000;
+  int tiles = 4096;
+  int reps = 50;
+  int warmup = 5;
+  uint64_t seed = 42;
+  const char *filter = "";
+};
+
+// One repetition: the nanoseconds the system took and how many entities it
+// went through.
+struct Sample {
+  double ns;
+  int entities;
+};
+
+static void report(const char *name, std::vector<Sample> samples) {
+  std::sort(samples.begin(), samples.end(),
+            [](auto &a, auto &b) { return a.ns < b.ns; });
+  auto at = [&](double q) {
+    return samples[std::min(samples.size() - 1, size_t(q * samples.size()))];
+  };
+  auto median = at(0.5);
+  fmt::print("{:<20}{:>9}{:>12.0f}{:>12.0f}{:>12.0f}{:>12.2f}\n", name,
+             median.entities, samples.front().ns, median.ns, at(0.9).ns,
+             median.ns / std::max(1, median.entities));
+}
+
+// Runs `rep` warmup + reps times and reports the timed ones. rep() returns
+// a Sample.
+template <typename F>
+static void run_case(const Config &config, const char *name, F &&rep) {
+  if (!std::strstr(name, config.filter)) {
+    return;
+  }
+  std::vector<Sample> samples;
+  for (int i = 0; i < config.warmup + config.reps; ++i) {
+    auto s = rep(i);
+    if (i >= config.warmup) {
+      samples.push_back(s);
+    }
+  }
+  report(name, std::move(samples));
+}
+
+// Uniform point in the disk of radius `r` around `center`.
+static Vector2 scatter(Rng &rng, Vector2 center, float r) {
+  auto angle = rng.value(0, 62831) / 10000.0f;
+  auto d = r * std::sqrt(rng.value(0, 10000) / 10000.0f);
+  return Vector2{center.x + d * std::cos(angle),
+                 center.y + d * std::sin(angle)};
+}
+
+// A world with the configured enemies around the player and nothing else
+// scheduled to spawn on the next step, with room for `extra` more entities
+// per pool.
+static std::unique_ptr<World> enemy_world(const Config &config, int rep,
+                                          int extra = 0) {
+  auto capacity = std::max({ENOUGH, config.enemies, config.bullets,
+                            config.gems}) + extra;
+  auto world = std::make_unique<World>(config.seed + rep, capacity);
+  world->frame_counter = 1;
+  world->player_hp = 1 << 30;
+  Rng rng;
+  rng.seed(config.seed * 31 + rep);
+  for (int i = 0; i < config.enemies; ++i) {
+    world->spawn_enemy(scatter(rng, world->player, config.radius), 50);
+  }
+  return world;
+}
+
+// Steps `world` once and returns what `phase` took.
+static double step_phase(World &world, Phase phase) {
+  PhaseTimes times;
+  world.timing = &times;
+  world.step(Input{});
+  world.timing = nullptr;
+  return double(times.ns[phase]);
+}
+
+static void chase_case(const Config &config) {
+  run_case(config, "chase", [&](int rep) {
+    auto world = enemy_world(config, rep);
+    auto &e = world->enemies;
+    auto start = Clock::now();
+    chase(e.x, e.y, e.alive, e.count, world->player, 3);
+    auto ns = std::chrono::duration<double, std::nano>(Clock::now() - start);
+    return Sample{ns.count(), e.count};
+  });
+}
+
+static void pickup_case(const Config &config) {
+  run_case(config, "pickup", [&](int rep) {
+    auto world = enemy_world(config, rep);
+    auto &g = world->experiences;
+    Rng rng;
+    rng.seed(config.seed + rep);
+    for (int i = 0; i < config.gems; ++i) {
+      auto slot = g.spawn();
+      auto p = scatter(rng, world->player, config.radius);
+      g.x[slot] = p.x;
+      g.y[slot] = p.y;
+      g.value[slot] = 1;
+    }
+    std::vector<int> out(g.capacity());
+    auto start = Clock::now();
+    within(g.x, g.y, g.alive, g.count, world->player, 64, out.data());
+    auto ns = std::chrono::duration<double, std::nano>(Clock::now() - start);
+    return Sample{ns.count(), g.count};
+  });
+}
+
+// Collision and then steering of bullets of one kind, per bullet.
+static void bullet_cases(const Config &config) {
+  for (int typ = BULLET_STRAIGHT; typ < BULLET_KIND_END; ++typ) {
+    auto setup = [&](int rep) {
+      auto world = enemy_world(config, rep);
+      Rng rng;
+      rng.seed(config.seed + rep);
+      for (int i = 0; i < config.bullets; ++i) {
+        world->spawn_bullet(scatter(rng, world->player, config.radius),
+                            Vector2{float(rng.value(-10, 10)),
+                                    float(rng.value(-10, 10))},
+                            BulletKind(typ));
+      }
+      return world;
+    };
+    auto collide_name = fmt::format("collide typ {}", typ);
+    run_case(config, collide_name.c_str(), [&](int rep) {
+      auto world = setup(rep);
+      auto n = world->bullets.count;
+      return Sample{step_phase(*world, PHASE_COLLIDE), n};
+    });
+    auto steer_name = fmt::format("steer typ {}", typ);
+    run_case(config, steer_name.c_str(), [&](int rep) {
+      auto world = setup(rep);
+      auto n = world->bullets.count;
+      return Sample{step_phase(*world, PHASE_STEER), n};
+    });
+  }
+}
+
+// Separation of a crowd 1/4 to 16 times the configured one, spread over a
+// proportionally larger disk so the density stays the same: the cost per
+// enemy should stay flat.
+static void separate_cases(const Config &config) {
+  for (int scale : {1, 4, 16, 64}) {
+    auto scaled = config;
+    scaled.enemies = config.enemies * scale / 4;
+    scaled.radius = config.radius * std::sqrt(scale / 4.0f);
+    auto name = fmt::format("separate x{}/4", scale);
+    run_case(config, name.c_str(), [&](int rep) {
+      auto world = enemy_world(scaled, rep);
+      auto n = world->enemies.count;
+      return Sample{step_phase(*world, PHASE_SEPARATE), n};
+    });
+  }
+}
+
+// The configured crowd plus 0 to 16 times as many enemies left far behind,
+// after enough ticks for all of those to go dormant: a dormant enemy should
+// only add the few byte operations that keep its tier to the chase and
+// separation cost per awake enemy.
+static void dormant_cases(const Config &config) {
+  for (int scale : {0, 4, 16}) {
+    auto name = fmt::format("dormant x{}", scale);
+    run_case(config, name.c_str(), [&](int rep) {
+      auto world = enemy_world(config, rep, config.enemies * scale);
+      Rng rng;
+      rng.seed(config.seed * 37 + rep);
+      auto far = Vector2{world->player.x + 20000, world->player.y};
+      for (int i = 0; i < config.enemies * scale; ++i) {
+        world->spawn_enemy(scatter(rng, far, config.radius), 50);
+      }
+      for (int i = 0; i < LOD_TICKS; ++i) {
+        world->step(Input{});
+      }
+      PhaseTimes times;
+      world->timing = &times;
+      world->step(Input{});
+      world->timing = nullptr;
+      return Sample{double(times.ns[PHASE_CHASE] + times.ns[PHASE_SEPARATE]),
+                    config.enemies};
+    });
+  }
+}
+
+static void rocket_cases(const Config &config) {
+  // The rocket starts on the player with every enemy at least 100 away, so
+  // the step is one nearest-enemy search over the crowd.
+  run_case(config, "rocket lock-on", [&](int rep) {
+    auto world = enemy_world(config, rep);
+    auto &e = world->enemies;
+    for (int i = 0; i < e.count; ++i) {
+      auto d = Vector2{e.x[i] - world->player.x, e.y[i] - world->player.y};
+      auto len = std::max(1.0f, std::sqrt(d.x * d.x + d.y * d.y));
+      if (len < 100) {
+        e.x[i] = world->player.x + d.x / len * 100;
+        e.y[i] = world->player.y + d.y / len * 100;
+      }
+    }
+    world->rocket = Rocket{world->player, Vector2{0, 0}, true};
+    return Sample{step_phase(*world, PHASE_ROCKET), e.count};
+  });
+  // One enemy sits on the rocket, which then blows up everything around.
+  run_case(config, "rocket explosion", [&](int rep) {
+    auto world = enemy_world(config, rep);
+    world->spawn_enemy(world->player, 50);
+    world->rocket = Rocket{world->player, Vector2{0, 0}, true};
+    auto before = world->enemies.count;
+    auto ns = step_phase(*world, PHASE_ROCKET);
+    return Sample{ns, before - world->enemies.count};
+  });
+}
+
+// Spawning a full crowd into an empty pool, killing every other one and
+// compacting, per entity.
+static void pool_case(const Config &config) {
+  run_case(config, "pool churn", [&](int rep) {
+    auto capacity = std::max(ENOUGH, config.enemies);
+    Arena arena(size_t(capacity) * 64 + (size_t(1) << 20));
+    Enemies pool;
+    pool.allocate(arena, capacity);
+    auto start = Clock::now();
+    for (int i = 0; i < config.enemies; ++i) {
+      pool.spawn();
+    }
+    for (int i = rep % 2; i < pool.count; i += 2) {
+      pool.kill(i);
+    }
+    pool.compact();
+    auto ns = std::chrono::duration<double, std::nano>(Clock::now() - start);
+    return Sample{ns.count(), config.enemies};
+  });
+}
+
+// Culling the background for a 1000x1000 view somewhere on the field, per
+// tile submitted.
+static void background_case(const Config &config) {
+  Rng rng;
+  rng.seed(config.seed);
+  std::vector<Rectangle> tiles(config.tiles);
+  for (auto &t : tiles) {
+    auto size = float(rng.value(400, 800));
+    t = Rectangle{float(rng.value(-10000, 10000)) - size / 2,
+                  float(rng.value(-10000, 10000)) - size / 2, size, size};
+  }
+  BackgroundIndex index;
+  index.build(tiles.data(), config.tiles, 1000);
+  std::vector<int> visible;
+  visible.reserve(config.tiles);
+  run_case(config, "background cull", [&](int) {
+    auto view = Rectangle{float(rng.value(-10000, 9000)),
+                          float(rng.value(-10000, 9000)), 1000, 1000};
+    visible.clear();
+    auto start = Clock::now();
+    index.query(tiles.data(), view, visible);
+    auto ns = std::chrono::duration<double, std::nano>(Clock::now() - start);
+    return Sample{ns.count(), int(visible.size())};
+  });
+}
+
+int main(int argc, char *argv[]) {
+  Config config;
+  for (int i = 1; i < argc; ++i) {
+    if (!std::strcmp(argv[i], "--enemies") && i + 1 < argc) {
+      config.enemies = std::max(0, std::atoi(argv[++i]));
+    } else if (!std::strcmp(argv[i], "--bullets") && i + 1 < argc) {
+      config.bullets = std::max(0, std::atoi(argv[++i]));
+    } else if (!std::strcmp(argv[i], "--gems") && i + 1 < argc) {
+      config.gems = std::max(0, std::atoi(argv[++i]));
+    } else if (!std::strcmp(argv[i], "--radius") && i + 1 < argc) {
+      config.radius = std::max(1.0, std::atof(argv[++i]));
+    } else if (!std::strcmp(argv[i], "--tiles") && i + 1 < argc) {
+      config.tiles = std::max(0, std::atoi(argv[++i]));
+    } else if (!std::strcmp(argv[i], "--reps") && i + 1 < argc) {
+      config.reps = std::max(1, std::atoi(argv[++i]));
+    } else if (!std::strcmp(argv[i], "--warmup") && i + 1 < argc) {
+      config.warmup = std::max(0, std::atoi(argv[++i]));
+    } else if (!std::strcmp(argv[i], "--seed") && i + 1 < argc) {
+      config.seed = std::strtoull(argv[++i], nullptr, 10);
+    } else if (!std::strcmp(argv[i], "--filter") && i + 1 < argc) {
+      config.filter = argv[++i];
+    } else {
+      fmt::print(stderr, "unknown argument: {}\n", argv[i]);
+      return 1;
+    }
+  }
+
+  fmt::print("enemies {}, bullets {}, gems {}, radius {}, tiles {}, "
+             "{} reps after {} warmup\n",
+             config.enemies, config.bullets, config.gems, config.radius,
+             config.tiles, config.reps, config.warmup);
+  fmt::print("{:<20}{:>9}{:>12}{:>12}{:>12}{:>12}\n", "case", "entities",
+             "min ns", "median ns", "p90 ns", "ns/entity");
+  chase_case(config);
+  pickup_case(config);
+  bullet_cases(config);
+  separate_cases(config);
+  dormant_cases(config);
+  rocket_cases(config);
+  pool_case(config);
+  background_case(config);
+  return 0;
+}
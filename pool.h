@@ -0,0 +1,115 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+#include "arena.h"
+
+// Refers to a pooled entity across compactions. A handle goes stale once the
+// entity it names is removed, even if its index is later reused.
+struct Handle {
+  int index = -1;
+  uint32_t generation = 0;
+};
+
+// Densely packed entity pool on top of a structure-of-arrays `Columns`.
+// Live entities occupy slots [0, count) so every pass only touches live
+// data. Spawning takes the next slot and a handle from a free list. Killing
+// clears the alive flag right away and queues the slot, and compact() then
+// swap-removes all queued slots, so slot numbers stay put until then.
+//
+// `Columns` provides an `alive` array, allocate(arena, n), which carves every
+// column out of `arena`, and move(dst, src), which copies every column of
+// slot src into slot dst. All storage is sized once by allocate(), nothing
+// is allocated per entity.
+template <typename Columns> struct Pool : Columns {
+  int count = 0;
+  int *slot_of = nullptr;
+  int *handle_of = nullptr;
+  uint32_t *generation = nullptr;
+  int *free_handles = nullptr;
+  int free_count = 0;
+  // Handles from here on were never handed out since the last clear(). They
+  // are used up in order once the free list is empty, which keeps clear()
+  // and allocate() from touching every handle.
+  int fresh = 0;
+  int *dying = nullptr;
+  int dying_count = 0;
+  int size = 0;
+
+  void allocate(Arena &arena, int capacity) {
+    size = capacity;
+    Columns::allocate(arena, capacity);
+    slot_of = arena.make<int>(capacity);
+    handle_of = arena.make<int>(capacity);
+    generation = arena.make<uint32_t>(capacity);
+    free_handles = arena.make<int>(capacity);
+    dying = arena.make<int>(capacity);
+    clear();
+  }
+
+  int capacity() const { return size; }
+
+  void clear() {
+    for (int i = 0; i < count; ++i) {
+      generation[handle_of[i]] += 1;
+      this->alive[i] = false;
+    }
+    count = 0;
+    dying_count = 0;
+    free_count = 0;
+    fresh = 0;
+  }
+
+  // Returns the slot of a new live entity, or -1 when the pool is full.
+  int spawn() {
+    if (count == size) {
+      return -1;
+    }
+    auto slot = count++;
+    auto h = free_count ? free_handles[--free_count] : fresh++;
+    slot_of[h] = slot;
+    handle_of[slot] = h;
+    this->alive[slot] = true;
+    return slot;
+  }
+
+  void kill(int slot) {
+    if (this->alive[slot]) {
+      this->alive[slot] = false;
+      dying[dying_count++] = slot;
+    }
+  }
+
+  void compact() {
+    // Highest slot first, so the last slot is never a queued one.
+    std::sort(dying, dying + dying_count, [](int a, int b) { return a > b; });
+    for (int i = 0; i < dying_count; ++i) {
+      auto slot = dying[i];
+      auto last = --count;
+      auto h = handle_of[slot];
+      generation[h] += 1;
+      free_handles[free_count++] = h;
+      if (slot != last) {
+        this->move(slot, last);
+        handle_of[slot] = handle_of[last];
+        slot_of[handle_of[slot]] = slot;
+      }
+      this->alive[last] = false;
+    }
+    dying_count = 0;
+  }
+
+  Handle handle(int slot) const {
+    return Handle{handle_of[slot], generation[handle_of[slot]]};
+  }
+
+  // Current slot of `h`, or -1 if that entity is gone.
+  int slot(Handle h) const {
+    if (h.index < 0 || generation[h.index] != h.generation) {
+      return -1;
+    }
+    auto s = slot_of[h.index];
+    return this->alive[s] ? s : -1;
+  }
+};
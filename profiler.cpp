@@ -0,0 +1,136 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+
+#include <fmt/format.h>
+
+// Zones from ZONE_TICK on.
+static const char *const OTHER_ZONE_NAMES[ZONE_COUNT - ZONE_TICK] = {
+    "tick", "background", "entities", "hud", "frame",
+};
+
+const char *zone_name(int zone) {
+  return zone < ZONE_TICK ? PHASE_NAMES[zone]
+                          : OTHER_ZONE_NAMES[zone - ZONE_TICK];
+}
+
+// Small per-thread number for the samples, handed out on first use.
+static int thread_number() {
+  static std::atomic<int> next{0};
+  thread_local int number = next.fetch_add(1);
+  return number;
+}
+
+Profiler::Profiler() : slots(std::make_unique<Slot[]>(CAPACITY)) {}
+
+void Profiler::record(int zone, uint64_t start, uint64_t end) {
+  auto n = head.fetch_add(1, std::memory_order_relaxed);
+  auto &slot = slots[n % CAPACITY];
+  slot.seq.store(2 * n + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.start.store(start, std::memory_order_relaxed);
+  slot.duration.store(end - start, std::memory_order_relaxed);
+  slot.tag.store(uint32_t(zone) | uint32_t(thread_number()) << 16,
+                 std::memory_order_relaxed);
+  slot.seq.store(2 * n + 2, std::memory_order_release);
+}
+
+void Profiler::read(std::vector<Sample> &out) const {
+  out.clear();
+  auto end = head.load(std::memory_order_acquire);
+  auto begin = end > CAPACITY ? end - CAPACITY : 0;
+  for (auto n = begin; n < end; ++n) {
+    auto &slot = slots[n % CAPACITY];
+    auto seq = slot.seq.load(std::memory_order_acquire);
+    if (seq != 2 * n + 2) {
+      continue;
+    }
+    auto start = slot.start.load(std::memory_order_relaxed);
+    auto duration = slot.duration.load(std::memory_order_relaxed);
+    auto tag = slot.tag.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.seq.load(std::memory_order_relaxed) != seq) {
+      continue;
+    }
+    out.push_back(Sample{int(tag & 0xffff), int(tag >> 16), start, duration});
+  }
+}
+
+void Profiler::stats(std::vector<Sample> &scratch, uint64_t window_ns,
+                     Stats out[ZONE_COUNT]) const {
+  read(scratch);
+  auto t = now();
+  auto since = t - std::min(t, window_ns);
+  // Sort by zone, then duration, so each zone's percentiles are plain
+  // indices into its run.
+  auto last = std::remove_if(scratch.begin(), scratch.end(), [&](auto &s) {
+    return s.start + s.duration < since;
+  });
+  std::sort(scratch.begin(), last, [](auto &a, auto &b) {
+    return a.zone != b.zone ? a.zone < b.zone : a.duration < b.duration;
+  });
+  for (int z = 0; z < ZONE_COUNT; ++z) {
+    out[z] = Stats{};
+  }
+  for (auto run = scratch.begin(); run != last;) {
+    auto zone = run->zone;
+    auto end =
+        std::find_if(run, last, [&](auto &s) { return s.zone != zone; });
+    auto n = int(end - run);
+    auto &st = out[zone];
+    st.count = n;
+    st.p50_us = run[n / 2].duration / 1e3;
+    st.p99_us = run[std::min(n - 1, n * 99 / 100)].duration / 1e3;
+    run = end;
+  }
+}
+
+using File = std::unique_ptr<FILE, decltype(&fclose)>;
+
+// Exports count time from the earliest sample still in the ring.
+static uint64_t origin(const std::vector<Profiler::Sample> &samples) {
+  uint64_t t = samples.empty() ? 0 : samples.front().start;
+  for (auto &s : samples) {
+    t = std::min(t, s.start);
+  }
+  return t;
+}
+
+bool Profiler::write_csv(const char *path) const {
+  File f(fopen(path, "w"), &fclose);
+  if (!f) {
+    return false;
+  }
+  std::vector<Sample> samples;
+  read(samples);
+  auto t0 = origin(samples);
+  fmt::print(f.get(), "zone,thread,start_us,duration_us\n");
+  for (auto &s : samples) {
+    fmt::print(f.get(), "{},{},{:.3f},{:.3f}\n", zone_name(s.zone),
+               s.thread, (s.start - t0) / 1e3, s.duration / 1e3);
+  }
+  return fflush(f.get()) == 0 && !ferror(f.get());
+}
+
+bool Profiler::write_trace(const char *path) const {
+  File f(fopen(path, "w"), &fclose);
+  if (!f) {
+    return false;
+  }
+  std::vector<Sample> samples;
+  read(samples);
+  auto t0 = origin(samples);
+  fmt::print(f.get(), "{{\"traceEvents\":[\n");
+  for (size_t i = 0; i < samples.size(); ++i) {
+    auto &s = samples[i];
+    fmt::print(f.get(),
+               "{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":1,\"tid\":{},"
+               "\"ts\":{:.3f},\"dur\":{:.3f}}}{}\n",
+               zone_name(s.zone), s.thread, (s.start - t0) / 1e3,
+               s.duration / 1e3, i + 1 < samples.size() ? "," : "");
+  }
+  fmt::print(f.get(), "]}}\n");
+  return fflush(f.get()) == 0 && !ferror(f.get());
+}
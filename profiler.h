@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "world.h"
+
+// Everything the profiler can time. The phases of World::step come first,
+// numbered as in Phase, then the whole tick and the sections of a drawn
+// frame.
+enum Zone {
+  ZONE_TICK = PHASE_COUNT,
+  ZONE_BACKGROUND,
+  ZONE_ENTITIES,
+  ZONE_HUD,
+  ZONE_FRAME,
+  ZONE_COUNT
+};
+
+// PHASE_NAMES for the phases.
+const char *zone_name(int zone);
+
+// Keeps the last CAPACITY timed zones from any number of threads in a ring.
+// Recording is wait-free: a writer claims a slot with one fetch_add and
+// publishes it with a sequence number, so a reader can copy the ring at any
+// time and skip the slots that are being overwritten under it.
+struct Profiler {
+  static constexpr uint64_t CAPACITY = 1 << 16;
+
+  struct Sample {
+    int zone;
+    int thread;
+    // steady_clock nanoseconds.
+    uint64_t start;
+    uint64_t duration;
+  };
+
+  struct Stats {
+    int count = 0;
+    double p50_us = 0;
+    double p99_us = 0;
+  };
+
+  Profiler();
+
+  static uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  void record(int zone, uint64_t start, uint64_t end);
+
+  // Replaces `out` with the samples still in the ring, oldest first.
+  void read(std::vector<Sample> &out) const;
+  // Median and 99th percentile duration per zone of the samples that ended
+  // within the last `window_ns`. `scratch` keeps the buffers between calls.
+  void stats(std::vector<Sample> &scratch, uint64_t window_ns,
+             Stats out[ZONE_COUNT]) const;
+
+  // Both return false on I/O errors. The trace is Chrome's JSON trace event
+  // format, for chrome://tracing or Perfetto.
+  bool write_csv(const char *path) const;
+  bool write_trace(const char *path) const;
+
+private:
+  struct Slot {
+    // 2 * n + 1 while sample n is written, 2 * n + 2 once it is complete.
+    std::atomic<uint64_t> seq{0};
+    std::atomic<uint64_t> start{0};
+    std::atomic<uint64_t> duration{0};
+    std::atomic<uint32_t> tag{0};
+  };
+
+  std::unique_ptr<Slot[]> slots;
+  std::atomic<uint64_t> head{0};
+};
+
+// Times the enclosing scope as `zone`. Does nothing without a profiler.
+struct ProfileScope {
+  Profiler *profiler;
+  int zone;
+  uint64_t start;
+
+  ProfileScope(Profiler *profiler, int zone)
+      : profiler(profiler), zone(zone), start(profiler ? Profiler::now() : 0) {
+  }
+  ~ProfileScope() {
+    if (profiler) {
+      profiler->record(zone, start, Profiler::now());
+    }
+  }
+  ProfileScope(const ProfileScope &) = delete;
+  ProfileScope &operator=(const ProfileScope &) = delete;
+};
@@ -0,0 +1,83 @@
+#include "render.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "bullets.h"
+
+constexpr int GEM_SIDES = 6;
+constexpr int ITEM_SIDES = 4;
+
+void reserve_entities(SpriteBatch &batch, Texture2D texture, int capacity) {
+  int bullet_sides = 0;
+  for (auto &shape : BULLET_SHAPES.of) {
+    bullet_sides = std::max(bullet_sides, shape.sides);
+  }
+  // A polygon takes a triangle per side, a square two triangles and a
+  // sprite one quad. Layers are flushed in turn, so the untextured bucket
+  // only has to hold the biggest of them.
+  auto pickups = capacity * (GEM_SIDES + ITEM_SIDES) * 3;
+  auto enemies = texture.id ? 0 : capacity * SpriteBatch::CIRCLE_SIDES * 3;
+  auto bullets = capacity * bullet_sides * 3;
+  batch.reserve(0, false, std::max({pickups, enemies, bullets}));
+  if (texture.id) {
+    batch.reserve(texture.id, true, capacity * 4);
+  }
+}
+
+void draw_entities(const Snapshot &prev, const Snapshot &curr, float alpha,
+                   Texture2D texture, Rectangle enemy_sprite,
+                   const EntityDetail &detail, SpriteBatch &batch,
+                   BatchBackend &backend) {
+  // Gems and items never move, they only appear and disappear.
+  for (int i = 0; i < curr.gem_count; ++i) {
+    auto color = curr.gem_typ[i] ? PINK : SKYBLUE;
+    if (detail.points) {
+      batch.square(curr.gem_pos[i], 5, color);
+    } else {
+      batch.poly(curr.gem_pos[i], GEM_SIDES, 8, color);
+    }
+  }
+  for (int i = 0; i < curr.item_count; ++i) {
+    if (detail.points) {
+      batch.square(curr.item_pos[i], 10, GOLD);
+    } else {
+      batch.poly(curr.item_pos[i], ITEM_SIDES, 16, GOLD);
+    }
+  }
+  batch.flush(backend);
+
+  auto &enemies = curr.enemies;
+  for (int i = 0; i < enemies.count; ++i) {
+    auto pos = enemies.at(i, prev.enemies, alpha);
+    if (texture.id == 0) {
+      batch.circle(pos, 16, RED);
+    } else {
+      batch.sprite(texture, enemy_sprite,
+                   Rectangle{pos.x, pos.y, enemy_sprite.width,
+                             enemy_sprite.height},
+                   WHITE);
+    }
+  }
+  batch.flush(backend);
+
+  auto &bullets = curr.bullets;
+  for (int i = 0; i < bullets.count; ++i) {
+    auto pos = bullets.at(i, prev.bullets, alpha);
+    auto &shape = BULLET_SHAPES.of[curr.bullet_typ[i]];
+    if (detail.points) {
+      batch.square(pos, 4, WHITE);
+    } else if (!shape.faces || !detail.rotate_bullets) {
+      batch.poly(pos, shape.sides, shape.radius, WHITE);
+    } else {
+      // DrawPoly rotated by atan2(dx, dy) puts the first vertex at
+      // {cos, sin} = {dy, dx} / |dv|.
+      auto dx = curr.bullet_dx[i];
+      auto dy = curr.bullet_dy[i];
+      auto len = std::sqrt(dx * dx + dy * dy);
+      auto facing = len > 0 ? Vector2{dy / len, dx / len} : Vector2{1, 0};
+      batch.poly(pos, shape.sides, shape.radius, facing, WHITE);
+    }
+  }
+  batch.flush(backend);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "raylib.h"
+
+#include "batch.h"
+#include "snapshot.h"
+
+// Cheaper ways to draw the entity layers, picked by the frame governor.
+struct EntityDetail {
+  // Turn triangle and square bullets towards their heading.
+  bool rotate_bullets = true;
+  // Gems, items and bullets as small squares instead of polygons.
+  bool points = false;
+};
+
+// Queues the gem, item, enemy and bullet layers into `batch` and flushes
+// after each textured/untextured switch, so the layers stack the same way
+// the per-entity draw calls did. Moving entities are drawn `alpha` of the
+// way from `prev` to `curr`. Enemies are the `enemy_sprite` rectangle of
+// `texture`, a zero `texture` falls back to circles.
+void draw_entities(const Snapshot &prev, const Snapshot &curr, float alpha,
+                   Texture2D texture, Rectangle enemy_sprite,
+                   const EntityDetail &detail, SpriteBatch &batch,
+                   BatchBackend &backend);
+
+// Makes room in `batch` for draw_entities to draw pools of `capacity` full
+// of their widest shapes, so drawing never allocates however crowded the
+// screen gets. `texture` is the one that will be passed to draw_entities.
+void reserve_entities(SpriteBatch &batch, Texture2D texture, int capacity);
@@ -0,0 +1,123 @@
+#include "replay.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#include <fmt/format.h>
+
+constexpr char MAGIC[4] = {'V', 'S', 'R', 'R'};
+constexpr uint32_t VERSION = 2;
+
+struct Header {
+  char magic[4];
+  uint32_t version;
+  uint64_t seed;
+  int32_t view_w;
+  int32_t view_h;
+  int32_t capacity;
+  uint64_t ticks;
+};
+
+using File = std::unique_ptr<FILE, decltype(&fclose)>;
+
+bool Recording::save(const char *path) const {
+  File f(fopen(path, "wb"), &fclose);
+  if (!f) {
+    return false;
+  }
+  Header header{};
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.seed = seed;
+  header.view_w = view_w;
+  header.view_h = view_h;
+  header.capacity = capacity;
+  header.ticks = ticks.size();
+  if (fwrite(&header, sizeof(header), 1, f.get()) != 1) {
+    return false;
+  }
+
+  std::vector<uint8_t> out;
+  for (size_t i = 0; i < ticks.size();) {
+    auto bits = ticks[i];
+    uint64_t run = 1;
+    while (i + run < ticks.size() && ticks[i + run] == bits) {
+      run += 1;
+    }
+    i += run;
+    out.push_back(bits);
+    do {
+      out.push_back((run & 0x7f) | (run > 0x7f ? 0x80 : 0));
+      run >>= 7;
+    } while (run);
+  }
+  return fwrite(out.data(), 1, out.size(), f.get()) == out.size() &&
+         fflush(f.get()) == 0;
+}
+
+bool Recording::load(const char *path) {
+  File f(fopen(path, "rb"), &fclose);
+  if (!f) {
+    return false;
+  }
+  Header header;
+  if (fread(&header, sizeof(header), 1, f.get()) != 1 ||
+      std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) ||
+      header.version != VERSION || header.capacity <= 0) {
+    return false;
+  }
+  seed = header.seed;
+  view_w = header.view_w;
+  view_h = header.view_h;
+  capacity = header.capacity;
+  ticks.clear();
+  ticks.reserve(header.ticks);
+  while (ticks.size() < header.ticks) {
+    auto bits = fgetc(f.get());
+    uint64_t run = 0;
+    int shift = 0;
+    int byte;
+    do {
+      byte = fgetc(f.get());
+      if (byte == EOF || shift > 56) {
+        return false;
+      }
+      run |= uint64_t(byte & 0x7f) << shift;
+      shift += 7;
+    } while (byte & 0x80);
+    if (bits == EOF || run > header.ticks - ticks.size()) {
+      return false;
+    }
+    ticks.insert(ticks.end(), run, uint8_t(bits));
+  }
+  return true;
+}
+
+void replay_tick(World &world, uint8_t tick) {
+  if (tick & Recording::RESTART) {
+    world.restart();
+  }
+  world.step(Input::from_bits(tick & ~Recording::RESTART));
+}
+
+void print_replay_report(
+    const std::vector<std::pair<uint64_t, uint64_t>> &checksums,
+    const PhaseTimes &times) {
+  for (auto [tick, sum] : checksums) {
+    fmt::print("tick {:>8}  checksum {:016x}\n", tick, sum);
+  }
+  auto ticks = std::max<uint64_t>(1, times.ticks);
+  uint64_t total = 0;
+  for (int p = 0; p < PHASE_COUNT; ++p) {
+    total += times.ns[p];
+  }
+  fmt::print("{:<10}{:>12}{:>8}\n", "phase", "ns/tick", "share");
+  for (int p = 0; p < PHASE_COUNT; ++p) {
+    fmt::print("{:<10}{:>12.0f}{:>7.1f}%\n", PHASE_NAMES[p],
+               double(times.ns[p]) / ticks,
+               100.0 * times.ns[p] / std::max<uint64_t>(1, total));
+  }
+  fmt::print("{:<10}{:>12.0f}\n", "total", double(total) / ticks);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "world.h"
+
+// Seed, view size and per-tick input of a run: everything a World needs to
+// go through exactly the same ticks again.
+//
+// On disk it is a small header followed by the ticks run-length encoded as
+// (bits, LEB128 run length) pairs, which keeps long stretches of holding the
+// same keys down to a couple of bytes.
+struct Recording {
+  // Set on the first tick after the world was restarted.
+  static constexpr uint8_t RESTART = 0x10;
+
+  uint64_t seed = 0;
+  int capacity = ENOUGH;
+  int view_w = 1000;
+  int view_h = 1000;
+  // Input::bits() of every tick, plus RESTART.
+  std::vector<uint8_t> ticks;
+
+  // Both return false on I/O errors or a malformed file.
+  bool save(const char *path) const;
+  bool load(const char *path);
+};
+
+// Applies one recorded tick to `world`.
+void replay_tick(World &world, uint8_t tick);
+
+// Prints the (tick, checksum) pairs and then how long each phase of a tick
+// took on average.
+void print_replay_report(
+    const std::vector<std::pair<uint64_t, uint64_t>> &checksums,
+    const PhaseTimes &times);
@@ -0,0 +1,248 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "bots.h"
+#include "jobs.h"
+#include "world.h"
+
+// Plays many whole games headless, with bots at the keys, and reports how
+// long each kind of bot survives, how fast it levels, how crowded its games
+// get and what a tick costs.
+// Usage: VSRO_runner [--games N] [--frames N] [--seed S] [--workers W]
+//                    [--policy NAME] [--capacity N] [--csv FILE]
+//   --games  games per policy (default 64), game g gets seed S + g.
+//   --frames  ticks a game may last at most (default ten minutes).
+//   --workers  threads to play on (default one per core).
+//   --policy  still, circle, kite, or all of them (default).
+//   --capacity  how many entities each pool holds (default ENOUGH).
+//   --csv  also write one line per game to FILE.
+//
+// Every game has its own World, bot and timings, and runs on one thread
+// from start to game over; the worlds share nothing, so the workers never
+// wait for each other. Each game is a chunk of its own: parallel_for deals
+// every thread a contiguous run of games up front, and a thread that gets
+// through its run early steals the games left at the far end of another's,
+// so long games don't hold up the pass.
+
+constexpr uint64_t MINUTE = 60 * 60;
+
+struct Game {
+  BotKind policy = BOT_STILL;
+  uint64_t seed = 0;
+  // Ticks until game over, or the cap.
+  uint64_t ticks = 0;
+  bool survived = false;
+  uint64_t level = 0;
+  // Level at the end of every whole minute played.
+  std::vector<uint64_t> minutes;
+  int peak_enemies = 0;
+  int peak_bullets = 0;
+  int peak_live = 0;
+  PhaseTimes times;
+  double ns = 0;
+};
+
+// Everything a game updates while it runs stays local until the end, so
+// neighbouring games in the result array never share a cache line while
+// they run.
+static void play(Game &game, uint64_t frames, int capacity) {
+  Game g = game;
+  World world(g.seed, capacity);
+  world.timing = &g.times;
+  auto bot = make_bot(g.policy);
+  auto start = std::chrono::steady_clock::now();
+  while (world.frame_counter < frames && !world.game_over) {
+    world.step(bot->decide(world));
+    if (world.frame_counter % MINUTE == 0 && !world.game_over) {
+      g.minutes.push_back(world.player_level);
+    }
+    g.peak_enemies = std::max(g.peak_enemies, world.enemies.count);
+    g.peak_bullets = std::max(g.peak_bullets, world.bullets.count);
+    g.peak_live = std::max(g.peak_live, world.live_entities());
+  }
+  auto end = std::chrono::steady_clock::now();
+  g.ns = std::chrono::duration<double, std::nano>(end - start).count();
+  g.ticks = world.frame_counter;
+  g.survived = !world.game_over;
+  g.level = world.player_level;
+  game = std::move(g);
+}
+
+// Value at quantile `q` of `v`, which gets sorted.
+template <typename T> static T quantile(std::vector<T> &v, double q) {
+  if (v.empty()) {
+    return T{};
+  }
+  std::sort(v.begin(), v.end());
+  return v[std::min(v.size() - 1, size_t(q * v.size()))];
+}
+
+static void report(const std::vector<Game> &games, BotKind policy) {
+  std::vector<double> seconds;
+  std::vector<uint64_t> levels;
+  std::vector<int> enemies;
+  std::vector<int> bullets;
+  std::vector<int> live;
+  PhaseTimes times;
+  uint64_t ticks = 0;
+  int survived = 0;
+  size_t longest = 0;
+  for (auto &g : games) {
+    if (g.policy != policy) {
+      continue;
+    }
+    seconds.push_back(g.ticks / 60.0);
+    levels.push_back(g.level);
+    enemies.push_back(g.peak_enemies);
+    bullets.push_back(g.peak_bullets);
+    live.push_back(g.peak_live);
+    for (int p = 0; p < PHASE_COUNT; ++p) {
+      times.ns[p] += g.times.ns[p];
+    }
+    ticks += g.ticks;
+    survived += g.survived;
+    longest = std::max(longest, g.minutes.size());
+  }
+  if (seconds.empty()) {
+    return;
+  }
+  fmt::print("\n{}: {} games, {} survived to the cap\n", BOT_NAMES[policy],
+             seconds.size(), survived);
+  fmt::print("{:<16}{:>10}{:>10}{:>10}{:>10}\n", "", "p10", "p50", "p90",
+             "max");
+  auto row = [](const char *name, auto &v) {
+    fmt::print("{:<16}{:>10}{:>10}{:>10}{:>10}\n", name, quantile(v, 0.1),
+               quantile(v, 0.5), quantile(v, 0.9), quantile(v, 1.0));
+  };
+  fmt::print("{:<16}{:>10.1f}{:>10.1f}{:>10.1f}{:>10.1f}\n", "survival s",
+             quantile(seconds, 0.1), quantile(seconds, 0.5),
+             quantile(seconds, 0.9), quantile(seconds, 1.0));
+  row("final level", levels);
+  row("peak enemies", enemies);
+  row("peak bullets", bullets);
+  row("peak live", live);
+
+  // Only the games still going at a minute count towards its level.
+  fmt::print("{:<8}{:>8}{:>10}{:>10}{:>10}\n", "minute", "alive", "p10 lvl",
+             "p50 lvl", "p90 lvl");
+  for (size_t m = 0; m < longest; ++m) {
+    std::vector<uint64_t> at;
+    for (auto &g : games) {
+      if (g.policy == policy && m < g.minutes.size()) {
+        at.push_back(g.minutes[m]);
+      }
+    }
+    fmt::print("{:<8}{:>8}{:>10}{:>10}{:>10}\n", m + 1, at.size(),
+               quantile(at, 0.1), quantile(at, 0.5), quantile(at, 0.9));
+  }
+
+  fmt::print("{:<16}", "us/tick");
+  for (int p = 0; p < PHASE_COUNT; ++p) {
+    fmt::print("{:>9}", PHASE_NAMES[p]);
+  }
+  fmt::print("\n{:<16}", "");
+  for (int p = 0; p < PHASE_COUNT; ++p) {
+    fmt::print("{:>9.1f}", times.ns[p] / std::max<double>(1, ticks) / 1e3);
+  }
+  fmt::print("\n");
+}
+
+static bool write_csv(const std::vector<Game> &games, const char *path) {
+  auto f = std::fopen(path, "w");
+  if (!f) {
+    return false;
+  }
+  fmt::print(f, "policy,seed,ticks,survived,level,peak_enemies,peak_bullets,"
+                "peak_live,ms\n");
+  for (auto &g : games) {
+    fmt::print(f, "{},{},{},{},{},{},{},{},{:.3f}\n", BOT_NAMES[g.policy],
+               g.seed, g.ticks, int(g.survived), g.level, g.peak_enemies,
+               g.peak_bullets, g.peak_live, g.ns / 1e6);
+  }
+  return std::fclose(f) == 0;
+}
+
+int main(int argc, char *argv[]) {
+  int games_per_policy = 64;
+  uint64_t frames = 10 * MINUTE;
+  uint64_t seed = 42;
+  int workers = std::max(1u, std::thread::hardware_concurrency());
+  const char *policy = "all";
+  int capacity = ENOUGH;
+  const char *csv_path = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    if (!std::strcmp(argv[i], "--games") && i + 1 < argc) {
+      games_per_policy = std::max(1, std::atoi(argv[++i]));
+    } else if (!std::strcmp(argv[i], "--frames") && i + 1 < argc) {
+      frames = std::strtoull(argv[++i], nullptr, 10);
+    } else if (!std::strcmp(argv[i], "--seed") && i + 1 < argc) {
+      seed = std::strtoull(argv[++i], nullptr, 10);
+    } else if (!std::strcmp(argv[i], "--workers") && i + 1 < argc) {
+      workers = std::max(1, std::atoi(argv[++i]));
+    } else if (!std::strcmp(argv[i], "--policy") && i + 1 < argc) {
+      policy = argv[++i];
+    } else if (!std::strcmp(argv[i], "--capacity") && i + 1 < argc) {
+      capacity = std::max(1, std::atoi(argv[++i]));
+    } else if (!std::strcmp(argv[i], "--csv") && i + 1 < argc) {
+      csv_path = argv[++i];
+    } else {
+      fmt::print(stderr, "unknown argument: {}\n", argv[i]);
+      return 1;
+    }
+  }
+
+  std::vector<BotKind> policies;
+  if (!std::strcmp(policy, "all")) {
+    for (int k = 0; k < BOT_KIND_COUNT; ++k) {
+      policies.push_back(BotKind(k));
+    }
+  } else if (bot_kind(policy) != BOT_KIND_COUNT) {
+    policies.push_back(bot_kind(policy));
+  } else {
+    fmt::print(stderr, "unknown policy: {}\n", policy);
+    return 1;
+  }
+
+  std::vector<Game> games(policies.size() * games_per_policy);
+  for (size_t j = 0; j < games.size(); ++j) {
+    games[j].policy = policies[j / games_per_policy];
+    games[j].seed = seed + j % games_per_policy;
+  }
+
+  JobSystem jobs(workers);
+  auto start = std::chrono::steady_clock::now();
+  jobs.parallel_for(int(games.size()), 1, [&](int, int begin, int end) {
+    for (int j = begin; j < end; ++j) {
+      play(games[j], frames, capacity);
+    }
+  });
+  auto end = std::chrono::steady_clock::now();
+
+  uint64_t ticks = 0;
+  for (auto &g : games) {
+    ticks += g.ticks;
+  }
+  auto s = std::chrono::duration<double>(end - start).count();
+  fmt::print("games:           {}\n", games.size());
+  fmt::print("workers:         {}\n", workers);
+  fmt::print("ticks:           {}\n", ticks);
+  fmt::print("total:           {:.1f} ms\n", s * 1e3);
+  fmt::print("ticks/s:         {:.0f}\n", ticks / s);
+  for (auto p : policies) {
+    report(games, p);
+  }
+  if (csv_path && !write_csv(games, csv_path)) {
+    fmt::print(stderr, "can't write {}\n", csv_path);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,163 @@
+#include "sim.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include <fmt/format.h>
+
+#include "checkpoint.h"
+#include "profiler.h"
+
+using Clock = std::chrono::steady_clock;
+constexpr auto TICK = std::chrono::duration_cast<Clock::duration>(
+    std::chrono::duration<double>(1.0 / Simulation::TICK_RATE));
+
+static double seconds(Clock::time_point t) {
+  return std::chrono::duration<double>(t.time_since_epoch()).count();
+}
+
+Simulation::Simulation(std::unique_ptr<World> w)
+    : Simulation(std::move(w), Options{}) {}
+
+Simulation::Simulation(std::unique_ptr<World> w, const Options &o)
+    : world(std::move(w)), options(o),
+      buffers(std::make_unique<Snapshot[]>(4)) {
+  if (options.replay) {
+    world->view_w = options.replay->view_w;
+    world->view_h = options.replay->view_h;
+  }
+  for (int i = 0; i < 4; ++i) {
+    buffers[i].capture(*world);
+    buffers[i].time = seconds(Clock::now());
+  }
+  thread = std::thread([this] { run(); });
+}
+
+Simulation::~Simulation() { stop(); }
+
+void Simulation::stop() {
+  stopping.store(true);
+  if (thread.joinable()) {
+    thread.join();
+  }
+}
+
+void Simulation::set_view(int w, int h) {
+  view_w.store(w);
+  view_h.store(h);
+}
+
+void Simulation::update() {
+  if (!(ready.load(std::memory_order_acquire) & FRESH)) {
+    return;
+  }
+  auto newest = ready.exchange(prev, std::memory_order_acq_rel) & ~FRESH;
+  prev = curr;
+  curr = newest;
+}
+
+float Simulation::alpha() const {
+  auto since = seconds(Clock::now()) - buffers[curr].time;
+  return std::clamp(float(since * TICK_RATE), 0.0f, 1.0f);
+}
+
+void Simulation::publish() {
+  buffers[back].capture(*world);
+  buffers[back].time = seconds(Clock::now());
+  back = ready.exchange(back | FRESH, std::memory_order_acq_rel) & ~FRESH;
+}
+
+bool Simulation::can_step() const {
+  if (paused.load()) {
+    return false;
+  }
+  if (options.replay) {
+    auto &ticks = options.replay->ticks;
+    return replay_pos < ticks.size() &&
+           (!world->game_over || (ticks[replay_pos] & Recording::RESTART));
+  }
+  return !world->game_over;
+}
+
+void Simulation::tick() {
+  uint8_t bits;
+  auto start = Clock::now();
+  ProfileScope scope(world->profiler, ZONE_TICK);
+  auto checked = options.alloc_warmup >= 0 &&
+                 ticks >= uint64_t(options.alloc_warmup);
+  trace_allocations(checked);
+  auto allocs_start = thread_allocations();
+  if (options.replay) {
+    bits = options.replay->ticks[replay_pos++];
+    replay_tick(*world, bits);
+  } else {
+    bits = input_bits.load();
+    if (restarted) {
+      bits |= Recording::RESTART;
+      restarted = false;
+    }
+    world->view_w = view_w.load();
+    world->view_h = view_h.load();
+    world->step(Input::from_bits(bits));
+  }
+  auto allocs = thread_allocations() - allocs_start;
+  trace_allocations(false);
+  last_step_ms.store(
+      std::chrono::duration<float, std::milli>(Clock::now() - start).count());
+  if (options.record) {
+    options.record->ticks.push_back(bits);
+  }
+  ticks += 1;
+  if (options.checksum_every > 0 && ticks % options.checksum_every == 0) {
+    sums.emplace_back(ticks, world->checksum());
+  }
+  trace_allocations(checked);
+  allocs_start = thread_allocations();
+  publish();
+  allocs += thread_allocations() - allocs_start;
+  trace_allocations(false);
+  alloc_count.fetch_add(allocs.count);
+  alloc_bytes.fetch_add(allocs.bytes);
+  alloc_frees.fetch_add(allocs.frees);
+  if (checked && allocs.count) {
+    allocating.fetch_add(1);
+  }
+}
+
+void Simulation::run() {
+  auto next = Clock::now();
+  while (!stopping.load()) {
+    if (restart_requested.exchange(false) && !options.replay) {
+      world->restart();
+      restarted = true;
+      publish();
+    }
+    if (checkpoint_requested.exchange(false) && options.checkpoint_path &&
+        !save_checkpoint(*world, options.checkpoint_path)) {
+      fmt::print(stderr, "can't write checkpoint {}\n",
+                 options.checkpoint_path);
+    }
+    if (options.replay) {
+      if (can_step()) {
+        tick();
+        continue;
+      }
+      replay_done.store(replay_pos == options.replay->ticks.size());
+      std::this_thread::sleep_for(TICK);
+      continue;
+    }
+    auto now = Clock::now();
+    if (!can_step()) {
+      next = now + TICK;
+    } else {
+      if (now - next > MAX_CATCH_UP * TICK) {
+        next = now;
+      }
+      while (next <= now && can_step()) {
+        tick();
+        next += TICK;
+      }
+    }
+    std::this_thread::sleep_until(next);
+  }
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "allocs.h"
+#include "replay.h"
+#include "snapshot.h"
+#include "world.h"
+
+// Steps a World on its own thread at a fixed rate, independent of how fast
+// frames are drawn, and hands the render loop snapshots of it.
+//
+// With a recording to replay, the ticks come from it instead of the live
+// input and run back to back as fast as the world can step.
+//
+// Snapshots go through four buffers: the one the simulation is writing, the
+// newest published one, and the two the renderer interpolates between.
+// Publishing and taking are a single atomic exchange each, so neither side
+// ever waits for the other.
+struct Simulation {
+  static constexpr int TICK_RATE = 60;
+  // A simulation that falls further behind than this drops the backlog and
+  // slows down instead of stepping in a burst.
+  static constexpr int MAX_CATCH_UP = 5;
+
+  struct Options {
+    // Every stepped tick is appended here.
+    Recording *record = nullptr;
+    // Ticks are taken from here; live input, view size and restarts are
+    // ignored.
+    const Recording *replay = nullptr;
+    // Collect the world checksum every this many ticks, 0 for never.
+    int checksum_every = 0;
+    // Where checkpoint() saves the world.
+    const char *checkpoint_path = nullptr;
+    // Ticks after this many count towards allocating_ticks() and have the
+    // stacks of their allocations printed, -1 for never.
+    int64_t alloc_warmup = -1;
+  };
+
+  explicit Simulation(std::unique_ptr<World> world);
+  Simulation(std::unique_ptr<World> world, const Options &options);
+  ~Simulation();
+  Simulation(const Simulation &) = delete;
+  Simulation &operator=(const Simulation &) = delete;
+
+  // Render thread side. Input, pause and view size take effect on the next
+  // tick; a restart is applied before it. The simulation starts paused.
+  void set_input(const Input &input) { input_bits.store(input.bits()); }
+  void set_paused(bool p) { paused.store(p); }
+  void set_view(int w, int h);
+  void restart() { restart_requested.store(true); }
+  // Saves the world to Options::checkpoint_path between two ticks.
+  void checkpoint() { checkpoint_requested.store(true); }
+
+  // Takes the newest snapshot if one was published since the last call.
+  // The references stay valid until the next call.
+  void update();
+  const Snapshot &previous() const { return buffers[prev]; }
+  const Snapshot &current() const { return buffers[curr]; }
+  // Fraction of a tick elapsed since current() was published, for drawing
+  // between previous() and current().
+  float alpha() const;
+  // Wall time the last tick spent in World::step, in milliseconds.
+  float step_ms() const { return last_step_ms.load(); }
+  // True once a replay has run out of ticks.
+  bool finished() const { return replay_done.load(); }
+  // What the simulation thread allocated stepping the world and publishing
+  // snapshots, over all ticks so far. Recording and checksums are left out.
+  AllocCount tick_allocations() const {
+    return AllocCount{alloc_count.load(), alloc_bytes.load(),
+                      alloc_frees.load()};
+  }
+  // Ticks past Options::alloc_warmup that allocated.
+  uint64_t allocating_ticks() const { return allocating.load(); }
+
+  // Stops the simulation thread. The world, the recording and the results
+  // below may only be looked at after this.
+  void stop();
+  const World &final_world() const { return *world; }
+  // (tick, checksum) pairs collected so far.
+  const std::vector<std::pair<uint64_t, uint64_t>> &checksums() const {
+    return sums;
+  }
+
+private:
+  void run();
+  bool can_step() const;
+  void tick();
+  void publish();
+
+  static constexpr int FRESH = 4;
+
+  std::unique_ptr<World> world;
+  Options options;
+  size_t replay_pos = 0;
+  bool restarted = false;
+  uint64_t ticks = 0;
+  std::vector<std::pair<uint64_t, uint64_t>> sums;
+  std::unique_ptr<Snapshot[]> buffers;
+  // Owned by the simulation thread.
+  int back = 3;
+  // Index of the newest published buffer, FRESH until the renderer took it.
+  std::atomic<int> ready{2};
+  // Owned by the render thread.
+  int prev = 0;
+  int curr = 1;
+
+  std::atomic<uint8_t> input_bits{0};
+  std::atomic<bool> paused{true};
+  std::atomic<bool> restart_requested{false};
+  std::atomic<bool> checkpoint_requested{false};
+  std::atomic<int> view_w{1000};
+  std::atomic<int> view_h{1000};
+  std::atomic<float> last_step_ms{0};
+  std::atomic<bool> replay_done{false};
+  std::atomic<uint64_t> alloc_count{0};
+  std::atomic<uint64_t> alloc_bytes{0};
+  std::atomic<uint64_t> alloc_frees{0};
+  std::atomic<uint64_t> allocating{0};
+  std::atomic<bool> stopping{false};
+  std::thread thread;
+};
@@ -0,0 +1,78 @@
+#include "snapshot.h"
+
+#include <algorithm>
+
+#include "raymath.h"
+
+// Nothing moves this far in one tick, only the player's wrap does.
+constexpr float MAX_STEP = 1000;
+
+Vector2 interpolate(Vector2 from, Vector2 to, float alpha) {
+  if (Vector2DistanceSqr(from, to) > MAX_STEP * MAX_STEP) {
+    return to;
+  }
+  return Vector2Lerp(from, to, alpha);
+}
+
+// Grows `v` to hold `n` entries without ever shrinking it. Called with the
+// pool's capacity, so only the first capture allocates.
+template <typename T> static void fit(std::vector<T> &v, int n) {
+  if (int(v.size()) < n) {
+    v.resize(n);
+  }
+}
+
+Vector2 Track::at(int i, const Track &prev, float alpha) const {
+  auto h = handle[i];
+  if (h.index >= int(prev.slot_of.size())) {
+    return pos(i);
+  }
+  auto s = prev.slot_of[h.index];
+  if (s < prev.count && prev.handle[s].index == h.index &&
+      prev.handle[s].generation == h.generation) {
+    return interpolate(prev.pos(s), pos(i), alpha);
+  }
+  return pos(i);
+}
+
+void Snapshot::capture(const World &world) {
+  enemies.capture(world.enemies);
+  bullets.capture(world.bullets);
+  auto &b = world.bullets;
+  fit(bullet_dx, b.capacity());
+  fit(bullet_dy, b.capacity());
+  fit(bullet_typ, b.capacity());
+  std::copy(b.dx, b.dx + b.count, bullet_dx.begin());
+  std::copy(b.dy, b.dy + b.count, bullet_dy.begin());
+  std::copy(b.typ, b.typ + b.count, bullet_typ.begin());
+
+  auto &e = world.experiences;
+  gem_count = e.count;
+  fit(gem_pos, e.capacity());
+  fit(gem_typ, e.capacity());
+  for (int i = 0; i < gem_count; ++i) {
+    gem_pos[i] = e.pos(i);
+  }
+  std::copy(e.typ, e.typ + e.count, gem_typ.begin());
+  item_count = world.items.count;
+  fit(item_pos, world.items.capacity());
+  std::copy(world.items.pos, world.items.pos + item_count, item_pos.begin());
+
+  rocket = world.rocket;
+  rocket_exploded = world.rocket_exploded;
+  auto target = world.enemies.slot(world.rocket_target);
+  rocket_locked = target >= 0;
+  if (rocket_locked) {
+    rocket_target = world.enemies.pos(target);
+  }
+  boss = world.boss;
+
+  player = world.player;
+  player_hp = world.player_hp;
+  player_experience = world.player_experience;
+  player_level = world.player_level;
+  player_dir = world.player_dir;
+  player_launches = world.player_launches;
+  frame_counter = world.frame_counter;
+  game_over = world.game_over;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "raylib.h"
+
+#include "world.h"
+
+// Positions of one pool's entities at the end of a tick, together with the
+// pool handle of each, so that the renderer can find where the same entity
+// was a snapshot earlier even after compaction has moved it to another slot.
+struct Track {
+  int count = 0;
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<Handle> handle;
+  // Handle index -> slot. Only entries of live entities are written, stale
+  // ones are caught by comparing the handle stored at the slot.
+  std::vector<int> slot_of;
+
+  // The vectors are sized for the whole pool on the first capture, so later
+  // captures never allocate.
+  template <typename P> void capture(const P &pool) {
+    count = pool.count;
+    x.resize(pool.capacity());
+    y.resize(pool.capacity());
+    handle.resize(pool.capacity());
+    slot_of.resize(pool.capacity());
+    for (int i = 0; i < count; ++i) {
+      x[i] = pool.x[i];
+      y[i] = pool.y[i];
+      handle[i] = pool.handle(i);
+      slot_of[handle[i].index] = i;
+    }
+  }
+
+  Vector2 pos(int i) const { return {x[i], y[i]}; }
+  // Where entity `i` is `alpha` of the way from `prev` to this snapshot.
+  // Entities that did not exist in `prev` are drawn where they are now.
+  Vector2 at(int i, const Track &prev, float alpha) const;
+};
+
+// Everything the render loop draws, copied out of a World at the end of a
+// tick. A snapshot is never written while the renderer holds it, so it can
+// be read without locking while the next tick is being simulated.
+struct Snapshot {
+  // steady_clock time of publication, in seconds.
+  double time = 0;
+
+  Track enemies;
+  Track bullets;
+  std::vector<float> bullet_dx;
+  std::vector<float> bullet_dy;
+  std::vector<int> bullet_typ;
+  int gem_count = 0;
+  std::vector<Vector2> gem_pos;
+  std::vector<int> gem_typ;
+  int item_count = 0;
+  std::vector<Vector2> item_pos;
+
+  Rocket rocket;
+  int rocket_exploded = 0;
+  bool rocket_locked = false;
+  Vector2 rocket_target{0, 0};
+  Boss boss;
+
+  Vector2 player{0, 0};
+  int player_hp = 0;
+  uint64_t player_experience = 0;
+  uint64_t player_level = 0;
+  int player_dir = 0;
+  int player_launches = 0;
+  uint64_t frame_counter = 0;
+  bool game_over = false;
+
+  void capture(const World &world);
+};
+
+// Linear interpolation that snaps instead of sweeping across the map when
+// the player wraps around the field edge.
+Vector2 interpolate(Vector2 from, Vector2 to, float alpha);
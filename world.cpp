@@ -0,0 +1,965 @@
+#include "world.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "raymath.h"
+
+#include "kernels.h"
+#include "profiler.h"
+
+// Chunk sizes of the parallel passes. The SIMD passes spend a few
+// nanoseconds per entity, while a homing bullet scans every enemy, so bullets
+// split much finer. Both are multiples of KERNEL_WIDTH so that every chunk
+// starts on an aligned lane and whole-lane kernels stay inside their chunk.
+constexpr int KERNEL_GRAIN = 512;
+constexpr int BULLET_GRAIN = 64;
+
+template <typename F>
+static void for_chunks(JobSystem *jobs, int n, int grain, F &&f) {
+  if (jobs) {
+    jobs->parallel_for(n, grain, f);
+  } else {
+    for (int c = 0, begin = 0; begin < n; ++c, begin += grain) {
+      f(c, begin, std::min(n, begin + grain));
+    }
+  }
+}
+
+const char *const PHASE_NAMES[PHASE_COUNT] = {
+    "spawn",   "contact", "chase",  "separate", "pickup",
+    "merge",   "collide", "steer",  "rocket",   "compact",
+};
+
+// Charges the time since the previous mark to a phase, in `times` and as a
+// profiler zone. Reads no clock when both are null.
+struct PhaseClock {
+  PhaseTimes *times;
+  Profiler *profiler;
+  uint64_t last = 0;
+
+  PhaseClock(PhaseTimes *times, Profiler *profiler)
+      : times(times), profiler(profiler) {
+    if (times || profiler) {
+      last = Profiler::now();
+    }
+    if (times) {
+      times->ticks += 1;
+    }
+  }
+
+  void mark(Phase phase) {
+    if (times || profiler) {
+      auto now = Profiler::now();
+      if (times) {
+        times->ns[phase] += now - last;
+      }
+      if (profiler) {
+        profiler->record(phase, last, now);
+      }
+      last = now;
+    }
+  }
+};
+
+// 64-bit FNV-1a.
+struct Fnv {
+  uint64_t hash = 0xcbf29ce484222325ull;
+
+  void bytes(const void *data, size_t size) {
+    auto p = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; ++i) {
+      hash = (hash ^ p[i]) * 0x100000001b3ull;
+    }
+  }
+  template <typename T> void add(const T *column, int count) {
+    bytes(column, sizeof(T) * count);
+  }
+  template <typename T> void add(const T &value) { bytes(&value, sizeof(T)); }
+};
+
+static bool collide_circles(Vector2 c1, float r1, Vector2 c2, float r2) {
+  return Vector2DistanceSqr(c1, c2) <= (r1 + r2) * (r1 + r2);
+}
+
+static bool point_in_circle(Vector2 p, Vector2 c, float r) {
+  return collide_circles(p, 0, c, r);
+}
+
+// Column length for `n` slots, whole kernel lanes.
+static int padded(int n) {
+  return (n + KERNEL_WIDTH - 1) / KERNEL_WIDTH * KERNEL_WIDTH;
+}
+
+void EnemyColumns::allocate(Arena &arena, int n) {
+  n = padded(n);
+  x = arena.make<float>(n);
+  y = arena.make<float>(n);
+  hp = arena.make<int>(n);
+  init_hp = arena.make<int>(n);
+  alive = arena.make<uint8_t>(n);
+  dormant = arena.make<uint8_t>(n);
+}
+
+void BulletColumns::allocate(Arena &arena, int n) {
+  n = padded(n);
+  x = arena.make<float>(n);
+  y = arena.make<float>(n);
+  dx = arena.make<float>(n);
+  dy = arena.make<float>(n);
+  alive = arena.make<uint8_t>(n);
+  typ = arena.make<int>(n);
+  lifetime = arena.make<int>(n);
+  damage = arena.make<int>(n);
+  target = arena.make<Handle>(n);
+}
+
+void ExperienceColumns::allocate(Arena &arena, int n) {
+  n = padded(n);
+  x = arena.make<float>(n);
+  y = arena.make<float>(n);
+  alive = arena.make<uint8_t>(n);
+  value = arena.make<int>(n);
+  typ = arena.make<int>(n);
+}
+
+void ItemColumns::allocate(Arena &arena, int n) {
+  pos = arena.make<Vector2>(n);
+  typ = arena.make<int>(n);
+  alive = arena.make<uint8_t>(n);
+}
+
+void EnemyColumns::move(int dst, int src) {
+  x[dst] = x[src];
+  y[dst] = y[src];
+  hp[dst] = hp[src];
+  init_hp[dst] = init_hp[src];
+  alive[dst] = alive[src];
+  dormant[dst] = dormant[src];
+}
+
+void BulletColumns::move(int dst, int src) {
+  x[dst] = x[src];
+  y[dst] = y[src];
+  dx[dst] = dx[src];
+  dy[dst] = dy[src];
+  alive[dst] = alive[src];
+  typ[dst] = typ[src];
+  lifetime[dst] = lifetime[src];
+  damage[dst] = damage[src];
+  target[dst] = target[src];
+}
+
+void ExperienceColumns::move(int dst, int src) {
+  x[dst] = x[src];
+  y[dst] = y[src];
+  alive[dst] = alive[src];
+  value[dst] = value[src];
+  typ[dst] = typ[src];
+}
+
+void ItemColumns::move(int dst, int src) {
+  pos[dst] = pos[src];
+  typ[dst] = typ[src];
+  alive[dst] = alive[src];
+}
+
+bool World::inside_the_field(Vector2 p, Vector2 q) const {
+  return q.x > p.x - view_w / 2 && q.y > p.y - view_h / 2 &&
+         q.x < p.x + view_w / 2 && q.y < p.y + view_h / 2;
+}
+
+void World::drop_xp(int enemy) {
+  auto value = enemies.init_hp[enemy] / 10;
+  auto i = experiences.spawn();
+  if (i >= 0) {
+    experiences.x[i] = enemies.x[enemy];
+    experiences.y[i] = enemies.y[enemy];
+    experiences.value[i] = value;
+    experiences.typ[i] = 0;
+  } else {
+    // A full pool still holds the gems killed this tick until compaction,
+    // so the value goes to the first one still alive. Should every gem
+    // have gone this tick, the player gets it straight away.
+    auto &e = experiences;
+    int keeper = 0;
+    while (keeper < e.count && !e.alive[keeper]) {
+      keeper += 1;
+    }
+    if (keeper < e.count) {
+      e.value[keeper] += value;
+      e.typ[keeper] = 1;
+    } else {
+      add_experience(value);
+    }
+  }
+}
+
+void World::add_experience(int value) {
+  player_experience += value;
+  if (player_experience >= pow(phi, player_level)) {
+    player_level = log2(player_experience) / log2(phi);
+  }
+}
+
+void World::merge_gems() {
+  auto &e = experiences;
+  if (merge_cursor >= e.count) {
+    merge_cursor = 0;
+    gem_cells.clear();
+  }
+  auto end = std::min(e.count, merge_cursor + std::max(MERGE_SLICE,
+                                                       e.count / MERGE_TICKS));
+  for (int i = merge_cursor; i < end; ++i) {
+    if (!e.alive[i]) {
+      continue;
+    }
+    if (gem_cells.full()) {
+      gem_cells.clear();
+    }
+    auto &keeper = gem_cells.at(int(std::floor(e.x[i] / MERGE_CELL)),
+                                int(std::floor(e.y[i] / MERGE_CELL)));
+    auto k = e.slot(keeper);
+    if (k >= 0 && k != i) {
+      e.value[k] += e.value[i];
+      e.typ[k] = 1;
+      e.kill(i);
+    } else {
+      keeper = e.handle(i);
+    }
+  }
+  merge_cursor = end;
+}
+
+void World::rebuild_enemy_grid() {
+  enemy_grid.clear();
+  for (int i = 0; i < enemies.count; ++i) {
+    if (enemies.alive[i] && !enemies.dormant[i]) {
+      enemy_grid.insert(i, enemies.pos(i));
+    }
+  }
+  enemy_grid.build();
+}
+
+int World::enemy_at(Vector2 p) const {
+  int found = -1;
+  enemy_grid.query(p, 16, [&](int idx) {
+    if (enemies.alive[idx] && (found < 0 || idx < found) &&
+        point_in_circle(p, enemies.pos(idx), 16)) {
+      found = idx;
+    }
+  });
+  return found;
+}
+
+int World::nearest_enemy(Vector2 p) const {
+  return enemy_grid.nearest(
+      p, std::numeric_limits<float>::max(),
+      [&](int idx) { return enemies.pos(idx); },
+      [&](int idx) { return enemies.alive[idx]; });
+}
+
+void World::rebuild_homing_grid() {
+  auto field = Rectangle{player.x - view_w / 2, player.y - view_h / 2,
+                         float(view_w / 2 * 2), float(view_h / 2 * 2)};
+  homing_grid.clear(field, 64);
+  for (int i = 0; i < enemies.count; ++i) {
+    if (enemies.alive[i] && inside_the_field(player, enemies.pos(i))) {
+      homing_grid.insert(i, enemies.pos(i));
+    }
+  }
+  homing_grid.build();
+}
+
+int World::chase_enemies(float speed) {
+  auto x = enemies.x;
+  auto y = enemies.y;
+  auto alive = enemies.alive;
+  auto dormant = enemies.dormant;
+  // Kept in locals, byte stores could otherwise alias the members.
+  auto awake = this->awake;
+  auto n = enemies.count;
+  auto due = int(frame_counter % LOD_TICKS);
+  auto r2 = ACTIVE_RADIUS * ACTIVE_RADIUS;
+  // Blocks never straddle a chunk, so each chunk only writes its own slots.
+  static_assert(KERNEL_GRAIN % LOD_BLOCK == 0 && LOD_BLOCK % KERNEL_WIDTH == 0);
+  for_chunks(jobs, n, KERNEL_GRAIN, [&](int c, int begin, int end) {
+    int count = 0;
+    for (int block = begin; block < end; block += LOD_BLOCK) {
+      auto block_end = std::min(end, block + LOD_BLOCK);
+      // Through the padding of the last lane too, the kernel reads it.
+      auto stop = block_end == n ? padded(n) : block_end;
+      int block_awake = 0;
+      for (int i = block; i < stop; ++i) {
+        awake[i] = alive[i] & !dormant[i];
+        block_awake += awake[i];
+      }
+      if (block_awake) {
+        chase(x + block, y + block, awake + block, block_end - block, player,
+              speed);
+      }
+      if (block / LOD_BLOCK % LOD_TICKS == due) {
+        uint8_t sleeping[LOD_BLOCK] = {};
+        for (int i = block; i < block_end; ++i) {
+          sleeping[i - block] = alive[i] & dormant[i];
+        }
+        chase(x + block, y + block, sleeping, block_end - block, player,
+              speed * LOD_TICKS);
+        block_awake = 0;
+        for (int i = block; i < block_end; ++i) {
+          auto dx = x[i] - player.x;
+          auto dy = y[i] - player.y;
+          dormant[i] = dx * dx + dy * dy > r2;
+          awake[i] = alive[i] & !dormant[i];
+          block_awake += awake[i];
+        }
+      }
+      count += block_awake;
+    }
+    chunk_count[c] = count;
+  });
+  int total = 0;
+  for (int c = 0; c < JobSystem::chunks(n, KERNEL_GRAIN); ++c) {
+    total += chunk_count[c];
+  }
+  return total;
+}
+
+// Fine cells for a crowd spread over a few screens, coarser beyond.
+static int crowd_cells(int count) { return std::max(16384, count * 8); }
+
+void World::separate_enemies(float speed, int count) {
+  auto push = float(speed * SEPARATION_PUSH);
+  crowd_grid.build(enemies.x, enemies.y, awake, enemies.count,
+                   SEPARATION_RADIUS, crowd_cells(count));
+  auto &g = crowd_grid;
+  // Rows are independent: each reads the coordinate copies in the grid
+  // and writes only the enemies of its own cells.
+  for_chunks(jobs, g.rows, 1, [&](int, int begin, int end) {
+    int ranges[6];
+    for (int cy = begin; cy < end; ++cy) {
+      auto row0 = std::max(cy - 1, 0);
+      auto row1 = std::min(cy + 1, g.rows - 1);
+      for (int cx = 0; cx < g.cols; ++cx) {
+        auto c = cy * g.cols + cx;
+        if (g.cell_start[c] == g.cell_start[c + 1]) {
+          continue;
+        }
+        for (int row = row0; row <= row1; ++row) {
+          ranges[2 * (row - row0)] = g.run_begin(cx, row);
+          ranges[2 * (row - row0) + 1] = g.run_end(cx, row);
+        }
+        for (int i = g.cell_start[c]; i < g.cell_start[c + 1]; ++i) {
+          auto d = repel(Vector2{g.x[i], g.y[i]}, g.x.data(), g.y.data(),
+                         ranges, row1 - row0 + 1, SEPARATION_RADIUS);
+          auto len = std::sqrt(d.x * d.x + d.y * d.y);
+          auto s = len > 1 ? push / len : push;
+          auto e = g.items[i];
+          enemies.x[e] += d.x * s;
+          enemies.y[e] += d.y * s;
+        }
+      }
+    }
+  });
+}
+
+void World::hit_enemy(int bullet, int enemy) {
+  bullets.lifetime[bullet] -= 1;
+  if (bullets.lifetime[bullet] <= 0) {
+    bullets.kill(bullet);
+  }
+  enemies.hp[enemy] -= bullets.damage[bullet];
+  if (enemies.hp[enemy] <= 0) {
+    enemies.kill(enemy);
+    drop_xp(enemy);
+  } else {
+    auto old = enemies.pos(enemy);
+    enemies.x[enemy] -= bullets.dx[bullet];
+    enemies.y[enemy] -= bullets.dy[bullet];
+    enemy_grid.relocate(enemy, old, enemies.pos(enemy));
+  }
+}
+
+void World::hit_boss(int bullet) {
+  boss.hp -= bullets.damage[bullet];
+  bullets.lifetime[bullet] -= 1;
+  if (bullets.lifetime[bullet] <= 0) {
+    bullets.kill(bullet);
+  }
+  if (boss.hp <= 0) {
+    boss.alive = false;
+  } else {
+    boss.pos = Vector2Add(
+        boss.pos, Vector2Scale(Vector2Subtract(player, boss.pos), -0.001));
+  }
+}
+
+// Writes an event of `type` for each of the `n` slots in `slots`, offset by
+// `begin`, and returns `n`.
+static int emit(EventType type, const int *slots, int n, int begin,
+                Event *out) {
+  for (int i = 0; i < n; ++i) {
+    out[i] = Event{type, slots[i] + begin, -1};
+  }
+  return n;
+}
+
+void World::explode(Vector2 at) {
+  int count = 0;
+  enemy_grid.query(at, 500, [&](int idx) {
+    if (enemies.alive[idx] && point_in_circle(enemies.pos(idx), at, 500)) {
+      picked[count++] = idx;
+    }
+  });
+  // Kills resolve in slot order, so XP drops the same whatever order the
+  // grid reported them in.
+  std::sort(picked, picked + count);
+  resolve(emit(EVENT_KILL, picked, count, 0, events));
+  rocket.alive = false;
+  rocket_exploded = 6;
+}
+
+void World::resolve(int count) {
+  for (int i = 0; i < count; ++i) {
+    auto &ev = events[i];
+    switch (ev.type) {
+    case EVENT_HIT:
+      if (bullets.alive[ev.subject] && enemies.alive[ev.object]) {
+        hit_enemy(ev.subject, ev.object);
+      }
+      break;
+    case EVENT_BOSS_HIT:
+      if (bullets.alive[ev.subject] && boss.alive) {
+        hit_boss(ev.subject);
+      }
+      break;
+    case EVENT_KILL:
+      if (enemies.alive[ev.subject]) {
+        enemies.kill(ev.subject);
+        drop_xp(ev.subject);
+      }
+      break;
+    case EVENT_PICKUP:
+      if (experiences.alive[ev.subject]) {
+        experiences.kill(ev.subject);
+        add_experience(experiences.value[ev.subject]);
+      }
+      break;
+    }
+  }
+}
+
+template <typename F> int World::collect(int n, int grain, F &&f) {
+  for_chunks(jobs, n, grain, [&](int c, int begin, int end) {
+    chunk_count[c] = f(begin, end, picked + begin);
+  });
+  int total = 0;
+  for (int c = 0, begin = 0; begin < n; ++c, begin += grain) {
+    std::memmove(picked + total, picked + begin, chunk_count[c] * sizeof(int));
+    total += chunk_count[c];
+  }
+  return total;
+}
+
+template <typename F> int World::detect(int n, int grain, F &&f) {
+  for_chunks(jobs, n, grain, [&](int c, int begin, int end) {
+    chunk_count[c] = f(begin, end, events + begin * EVENTS_PER_SLOT);
+  });
+  int total = 0;
+  for (int c = 0, begin = 0; begin < n; ++c, begin += grain) {
+    std::memmove(events + total, events + begin * EVENTS_PER_SLOT,
+                 chunk_count[c] * sizeof(Event));
+    total += chunk_count[c];
+  }
+  return total;
+}
+
+void World::group_bullets() {
+  std::fill(kind_start, kind_start + BULLET_KINDS + 1, 0);
+  for (int b = 0; b < bullets.count; ++b) {
+    if (bullets.alive[b]) {
+      kind_start[bullets.typ[b] - BULLET_STRAIGHT + 1] += 1;
+    }
+  }
+  for (int k = 1; k <= BULLET_KINDS; ++k) {
+    kind_start[k] += kind_start[k - 1];
+  }
+  int next[BULLET_KINDS];
+  std::copy(kind_start, kind_start + BULLET_KINDS, next);
+  for (int b = 0; b < bullets.count; ++b) {
+    if (bullets.alive[b]) {
+      kind_slots[next[bullets.typ[b] - BULLET_STRAIGHT]++] = b;
+    }
+  }
+}
+
+template <BulletKind K>
+int World::steer_kind(const int *slots, int n, int *out) {
+  using T = BulletTraits<K>;
+  int count = 0;
+  for (int i = 0; i < n; ++i) {
+    auto b = slots[i];
+    auto pos = bullets.pos(b);
+    if constexpr (T::seek == BulletSeek::NEAREST) {
+      auto min_d = std::numeric_limits<float>::max();
+      auto min_idx = 0;
+      if (aim[b] >= 0) {
+        min_d = Vector2Distance(pos, enemies.pos(aim[b]));
+        min_idx = aim[b];
+      } else if (aim[b] == -1) {
+        auto e = homing_grid.nearest(pos);
+        if (e >= 0) {
+          min_d = Vector2Distance(enemies.pos(e), pos);
+          min_idx = e;
+          bullets.target[b] = enemies.handle(e);
+        }
+      }
+      auto to = Vector2{enemies.x[min_idx] - pos.x, enemies.y[min_idx] - pos.y};
+      auto dv = T::turn(bullets.dv(b), to, min_d, float(player_level));
+      bullets.dx[b] = dv.x;
+      bullets.dy[b] = dv.y;
+    } else if constexpr (T::seek == BulletSeek::ORBIT) {
+      if (aim[b] == -1) {
+        auto d = Vector2Distance(player, pos);
+        auto dx = (player.x - pos.x) / d;
+        auto dy = (player.y - pos.y) / d;
+        if (d > ORBIT_RADIUS) {
+          bullets.dx[b] = (-10 * dy + 0.1 * dx) / 2;
+          bullets.dy[b] = (10 * dx + 0.1 * dy) / 2;
+        } else if (d < ORBIT_RADIUS) {
+          bullets.dx[b] = (-10 * dy - 0.1 * dx) / 2;
+          bullets.dy[b] = (10 * dx - 0.1 * dy) / 2;
+        }
+        bullets.dx[b] = std::min(10.0f, bullets.dx[b]);
+        bullets.dy[b] = std::min(10.0f, bullets.dy[b]);
+      }
+    }
+    bullets.x[b] += bullets.dx[b];
+    bullets.y[b] += bullets.dy[b];
+    if (Vector2Distance(player, bullets.pos(b)) > 1000) {
+      out[count++] = b;
+    }
+  }
+  return count;
+}
+
+uint64_t World::checksum() const {
+  Fnv f;
+  f.add(enemies.x, enemies.count);
+  f.add(enemies.y, enemies.count);
+  f.add(enemies.hp, enemies.count);
+  f.add(enemies.dormant, enemies.count);
+  f.add(bullets.x, bullets.count);
+  f.add(bullets.y, bullets.count);
+  f.add(bullets.dx, bullets.count);
+  f.add(bullets.dy, bullets.count);
+  f.add(bullets.typ, bullets.count);
+  f.add(bullets.lifetime, bullets.count);
+  f.add(experiences.x, experiences.count);
+  f.add(experiences.y, experiences.count);
+  f.add(experiences.value, experiences.count);
+  f.add(items.pos, items.count);
+  f.add(rocket.pos);
+  f.add(rocket.dv);
+  f.add(rocket.alive);
+  f.add(boss.pos);
+  f.add(boss.hp);
+  f.add(boss.alive);
+  f.add(player);
+  f.add(player_hp);
+  f.add(player_experience);
+  f.add(player_level);
+  f.add(frame_counter);
+  f.add(game_over);
+  f.add(merge_cursor);
+  f.add(rng.state);
+  return f.hash;
+}
+
+int World::live_entities() const {
+  return rocket.alive + boss.alive + enemies.count + bullets.count +
+         experiences.count + items.count;
+}
+
+World::World(uint64_t seed, int capacity)
+    : arena(size_t(capacity) * 512 + (size_t(64) << 20)) {
+  enemies.allocate(arena, capacity);
+  bullets.allocate(arena, capacity);
+  experiences.allocate(arena, capacity);
+  items.allocate(arena, capacity);
+  gem_cells.allocate(arena, capacity);
+  picked = arena.make<int>(capacity);
+  aim = arena.make<int>(capacity);
+  chunk_count = arena.make<int>(capacity);
+  events = arena.make<Event>(size_t(capacity) * EVENTS_PER_SLOT);
+  kind_slots = arena.make<int>(capacity);
+  awake = arena.make<uint8_t>(padded(capacity));
+  // The grids are rebuilt every tick; with room for every enemy up front
+  // they never allocate while the game runs.
+  enemy_grid.reserve(capacity);
+  homing_grid.reserve(capacity);
+  crowd_grid.reserve(capacity, crowd_cells(capacity));
+  rng.seed(seed);
+}
+
+int World::spawn_enemy(Vector2 pos, int hp) {
+  auto e = enemies.spawn();
+  if (e >= 0) {
+    enemies.x[e] = pos.x;
+    enemies.y[e] = pos.y;
+    enemies.init_hp[e] = hp;
+    enemies.hp[e] = hp;
+    enemies.dormant[e] = false;
+  }
+  return e;
+}
+
+int World::spawn_bullet(Vector2 pos, Vector2 dv, BulletKind kind) {
+  auto b = bullets.spawn();
+  if (b >= 0) {
+    bullets.x[b] = pos.x;
+    bullets.y[b] = pos.y;
+    bullets.dx[b] = dv.x;
+    bullets.dy[b] = dv.y;
+    bullets.typ[b] = kind;
+    arm_bullet(b);
+  }
+  return b;
+}
+
+void World::arm_bullet(int b) {
+  for_each_bullet_kind([&](auto kind) {
+    using T = BulletTraits<kind()>;
+    if (bullets.typ[b] == kind()) {
+      bullets.damage[b] = T::damage;
+      bullets.lifetime[b] = T::lifetime;
+    }
+  });
+  bullets.target[b] = Handle{};
+}
+
+void World::restart() {
+  game_over = false;
+  frame_counter = 0;
+  player_experience = 0;
+  player_level = 0;
+  player_hp = 1000;
+  enemies.clear();
+  bullets.clear();
+  experiences.clear();
+  gem_cells.clear();
+  merge_cursor = 0;
+  rocket.alive = false;
+  player = {0, 0};
+}
+
+void World::step(const Input &input) {
+  PhaseClock clock(timing, profiler);
+  auto w = view_w;
+  auto h = view_h;
+
+  if (rocket_exploded) {
+    rocket_exploded -= 1;
+  }
+  if (player_launches > 0) {
+    player_launches -= 1;
+  }
+
+  player_speed = 2 + player_level;
+  int freq = 30 - 30 * ((frame_counter % 3600) / 3600.0);
+  if (frame_counter % std::max(1, freq) == 0) {
+    for (uint64_t i = 0; i < player_level + 1; ++i) {
+      auto e = enemies.spawn();
+      if (e >= 0) {
+        int dir = rng.value(1, 4);
+        switch (dir) {
+        case 1:
+          enemies.x[e] = player.x - w / 2 - 20;
+          enemies.y[e] = rng.value(player.y - h / 2, player.y + h / 2);
+          break;
+        case 2:
+          enemies.x[e] = player.x + w / 2 + 20;
+          enemies.y[e] = rng.value(player.y - h / 2, player.y + h / 2);
+          break;
+        case 3:
+          enemies.y[e] = player.y - h / 2 - 20;
+          enemies.x[e] = rng.value(player.x - w / 2, player.x + w / 2);
+          break;
+        case 4:
+          enemies.y[e] = player.y + h / 2 + 20;
+          enemies.x[e] = rng.value(player.x - w / 2, player.x + w / 2);
+          break;
+        default:
+          break;
+        }
+        enemies.init_hp[e] = rng.value(5, 50);
+        enemies.hp[e] = enemies.init_hp[e];
+        enemies.dormant[e] = false;
+      }
+    }
+  }
+
+  if (frame_counter % (player_level >= 10 ? 1 : (10 - player_level)) == 0) {
+    for (uint64_t i = 0; i < player_level + 1; ++i) {
+      auto b = bullets.spawn();
+      if (b >= 0) {
+        bullets.x[b] = player.x;
+        bullets.y[b] = player.y;
+        bullets.dx[b] = rng.value(-10, 10);
+        bullets.dy[b] = rng.value(-10, 10);
+        bullets.typ[b] = rng.value(BULLET_STRAIGHT, BULLET_KIND_END - 1);
+        if (bullets.typ[b] == BULLET_ORBIT) {
+          if (rng.value(0, 1)) {
+            bullets.x[b] += (-1 * rng.value(-1, 1)) * 64;
+            bullets.dx[b] = 0;
+          } else {
+            bullets.y[b] += (-1 * rng.value(-1, 1)) * 64;
+            bullets.dy[b] = 0;
+          }
+        }
+        arm_bullet(b);
+      }
+    }
+  }
+
+  if (frame_counter % (1200 / (player_level + 1)) == 0) {
+    if (!rocket.alive) {
+      rocket.pos = player;
+      rocket.dv =
+          Vector2{(float)rng.value(-10, 10), (float)rng.value(-10, 10)};
+      rocket.alive = true;
+      player_launches = 30;
+    }
+  }
+
+  if (frame_counter % 600 == 0) {
+    auto i = items.spawn();
+    if (i >= 0) {
+      items.pos[i] = Vector2{(float)rng.value(-10000, 10000),
+                             (float)rng.value(-10000, 10000)};
+      items.typ[i] = 1;
+    }
+  }
+
+  if (!boss.alive && (frame_counter % (60 * 60 * 10) == 0)) {
+    boss.alive = true;
+    boss.hp = 1000000;
+    boss.pos = Vector2{10000, 10000};
+  }
+
+  clock.mark(PHASE_SPAWN);
+
+  rebuild_enemy_grid();
+  enemy_grid.query(player, 32 + 16, [&](int idx) {
+    if (collide_circles(player, 32, enemies.pos(idx), 16)) {
+      player_hp -= 1;
+      if (player_hp <= 0) {
+        game_over = true;
+      }
+    }
+  });
+
+  clock.mark(PHASE_CONTACT);
+
+  auto speed = std::max(1.0, player_level / 3.0);
+  auto awake_count = chase_enemies(speed);
+
+  clock.mark(PHASE_CHASE);
+
+  separate_enemies(speed, awake_count);
+
+  clock.mark(PHASE_SEPARATE);
+
+  auto pickup_radius = 32 + pow(1.3, player_level) + 8;
+  auto pick = [&](int begin, int end, Event *out) {
+    auto slots = picked + begin;
+    auto n = within(experiences.x + begin, experiences.y + begin,
+                    experiences.alive + begin, end - begin, player,
+                    pickup_radius, slots);
+    return emit(EVENT_PICKUP, slots, n, begin, out);
+  };
+  resolve(detect(experiences.count, KERNEL_GRAIN, pick));
+
+  for (int i = 0; i < items.count; ++i) {
+    if (items.alive[i]) {
+      if (collide_circles(player, 32, items.pos[i], 16)) {
+        for (int e = 0; e < experiences.count; ++e) {
+          if (experiences.alive[e]) {
+            experiences.kill(e);
+            add_experience(experiences.value[e]);
+          }
+        }
+        items.kill(i);
+      }
+    }
+  }
+
+  clock.mark(PHASE_PICKUP);
+
+  merge_gems();
+
+  clock.mark(PHASE_MERGE);
+
+  rebuild_enemy_grid();
+
+  // Detection reads the enemies and the boss as they were at the start of
+  // the phase and writes only each bullet's own aim, so it runs in parallel.
+  // A bullet hits the boss and at most one enemy a tick: its target if it
+  // reached it, the lowest slot at its position otherwise. The hits are then
+  // applied in bullet order, and a hit on an enemy that an earlier bullet
+  // killed is dropped.
+  auto collide = [&](int begin, int end, Event *out) {
+    int count = 0;
+    for (int b = begin; b < end; ++b) {
+      if (!bullets.alive[b]) {
+        continue;
+      }
+      auto pos = bullets.pos(b);
+      auto lifetime = bullets.lifetime[b];
+      if (boss.alive && point_in_circle(pos, boss.pos, 64)) {
+        out[count++] = Event{EVENT_BOSS_HIT, b, -1};
+        lifetime -= 1;
+      }
+      aim[b] = -1;
+      if (lifetime <= 0) {
+        continue;
+      }
+      auto e = enemies.slot(bullets.target[b]);
+      if (e >= 0 && !point_in_circle(pos, enemies.pos(e), 16)) {
+        aim[b] = e;
+        continue;
+      }
+      auto hit = e >= 0 ? e : enemy_at(pos);
+      if (hit >= 0) {
+        out[count++] = Event{EVENT_HIT, b, hit};
+        aim[b] = -2;
+      }
+    }
+    return count;
+  };
+  resolve(detect(bullets.count, BULLET_GRAIN, collide));
+
+  clock.mark(PHASE_COLLIDE);
+
+  // Steering only reads the enemies, so it runs in parallel.
+  rebuild_homing_grid();
+  group_bullets();
+  for_each_bullet_kind([&](auto kind) {
+    auto slots = kind_slots + kind_start[kind() - BULLET_STRAIGHT];
+    auto n = kind_start[kind() - BULLET_STRAIGHT + 1] -
+             kind_start[kind() - BULLET_STRAIGHT];
+    auto steer = [&](int begin, int end, int *out) {
+      return steer_kind<kind()>(slots + begin, end - begin, out);
+    };
+    auto out_of_range = collect(n, BULLET_GRAIN, steer);
+    for (int i = 0; i < out_of_range; ++i) {
+      bullets.kill(picked[i]);
+    }
+  });
+  clock.mark(PHASE_STEER);
+
+  if (rocket.alive) {
+    if (boss.alive) {
+      if (point_in_circle(rocket.pos, boss.pos, 64)) {
+        boss.hp -= 1000;
+        if (boss.hp <= 0) {
+          boss.alive = false;
+        }
+      }
+    }
+    auto target_slot = enemies.slot(rocket_target);
+    if (rocket_target_locked && target_slot >= 0) {
+      auto target = enemies.pos(target_slot);
+      if (point_in_circle(rocket.pos, target, 16)) {
+        explode(rocket.pos);
+        rocket_target_locked = false;
+      }
+      if (rocket.alive && enemies.alive[target_slot]) {
+        auto d = Vector2Distance(rocket.pos, target);
+        auto dx = (player_level + 5) * (target.x - rocket.pos.x) / d;
+        auto dy = (player_level + 5) * (target.y - rocket.pos.y) / d;
+        rocket.dv = Vector2Clamp(
+            Vector2Scale(Vector2Add(rocket.dv, Vector2{dx, dy}), 0.5),
+            Vector2{-10, -10}, Vector2{10, 10});
+        rocket.pos = Vector2Add(rocket.pos, rocket.dv);
+      }
+    } else {
+      rocket_target_locked = false;
+      auto min_d = std::numeric_limits<float>::max();
+      auto min_idx = 0;
+      auto e = nearest_enemy(rocket.pos);
+      if (e >= 0) {
+        if (point_in_circle(rocket.pos, enemies.pos(e), 16)) {
+          explode(rocket.pos);
+        }
+        min_d = Vector2Distance(rocket.pos, enemies.pos(e));
+        min_idx = e;
+      }
+      if (rocket.alive) {
+        auto dx = 5 * (enemies.x[min_idx] - rocket.pos.x) / min_d;
+        auto dy = 5 * (enemies.y[min_idx] - rocket.pos.y) / min_d;
+        rocket.dv = Vector2Clamp(
+            Vector2Scale(Vector2Add(rocket.dv, Vector2{dx, dy}), 0.5),
+            Vector2{-10, -10}, Vector2{10, 10});
+        rocket.pos = Vector2Add(rocket.pos, rocket.dv);
+        rocket_target_locked = true;
+        rocket_target = enemies.handle(min_idx);
+      }
+    }
+  }
+
+  if (boss.alive) {
+    auto d = Vector2Distance(player, boss.pos);
+    if (d < 64) {
+      game_over = true;
+    } else {
+      auto dx = (player.x - boss.pos.x) / d;
+      auto dy = (player.y - boss.pos.y) / d;
+      boss.pos.x += ((player_level + 1) / 3) * dx;
+      boss.pos.y += ((player_level + 1) / 3) * dy;
+    }
+  }
+
+  if (input.left) {
+    player_dir = 0;
+    player.x -= player_speed;
+  }
+  if (input.right) {
+    player_dir = 1;
+    player.x += player_speed;
+  }
+  if (input.up) {
+    player.y -= player_speed;
+  }
+  if (input.down) {
+    player.y += player_speed;
+  }
+
+  if (player.x < -10000) {
+    player.x += 20000;
+  }
+  if (player.x > 10000) {
+    player.x -= 20000;
+  }
+  if (player.y < -10000) {
+    player.y += 20000;
+  }
+  if (player.y > 10000) {
+    player.y -= 20000;
+  }
+
+  clock.mark(PHASE_ROCKET);
+
+  enemies.compact();
+  bullets.compact();
+  experiences.compact();
+  items.compact();
+
+  if (!game_over) {
+    frame_counter += 1;
+    player_hp = std::min(uint64_t(player_hp + 1), 1000 + 100 * player_level);
+  }
+  clock.mark(PHASE_COMPACT);
+}
@@ -0,0 +1,305 @@
+#pragma once
+
+#include <cstdint>
+
+#include "raylib.h"
+
+#include "bullets.h"
+#include "events.h"
+#include "grid.h"
+#include "jobs.h"
+#include "pool.h"
+
+// Default pool capacity.
+constexpr int ENOUGH = 4096;
+constexpr double phi = 1.61803398875;
+// Gems closer than this are merged into one.
+constexpr float MERGE_CELL = 128;
+// Ticks a merge sweep over the whole gem pool is spread over, and the
+// smallest slice worth a tick.
+constexpr int MERGE_TICKS = 4;
+constexpr int MERGE_SLICE = 256;
+// Enemies closer than this push each other apart, by at most SEPARATION_PUSH
+// times the chase speed a tick however crowded they are, so a crowd holds
+// its shape against the pull towards the player.
+constexpr float SEPARATION_RADIUS = 32;
+constexpr float SEPARATION_PUSH = 1.5;
+// Enemies farther than ACTIVE_RADIUS from the player go dormant: they are
+// left out of separation, contact, collisions and explosions, and chase the
+// player in one LOD_TICKS times longer step every LOD_TICKS ticks. The pool
+// is cut into blocks of LOD_BLOCK slots that take turns, and a block
+// rechecks the distance of all its enemies on its tick. The radius leaves
+// room for the player and an enemy to close in on each other for LOD_TICKS
+// ticks before the enemy can reach the field or a bullet.
+constexpr float ACTIVE_RADIUS = 2000;
+constexpr int LOD_TICKS = 8;
+constexpr int LOD_BLOCK = 64;
+// Most events a detection pass finds per item: a bullet can hit the boss
+// and an enemy in the same tick.
+constexpr int EVENTS_PER_SLOT = 2;
+
+// Columns the SIMD kernels stream over are padded to whole lanes and start
+// on a 64-byte boundary.
+struct EnemyColumns {
+  float *x = nullptr;
+  float *y = nullptr;
+  int *hp = nullptr;
+  int *init_hp = nullptr;
+  uint8_t *alive = nullptr;
+  // Set for enemies beyond ACTIVE_RADIUS at their block's last check.
+  uint8_t *dormant = nullptr;
+
+  Vector2 pos(int i) const { return {x[i], y[i]}; }
+  void allocate(Arena &arena, int n);
+  void move(int dst, int src);
+};
+
+struct BulletColumns {
+  float *x = nullptr;
+  float *y = nullptr;
+  float *dx = nullptr;
+  float *dy = nullptr;
+  uint8_t *alive = nullptr;
+  int *typ = nullptr;
+  int *lifetime = nullptr;
+  int *damage = nullptr;
+  // Enemy a homing bullet is locked on to.
+  Handle *target = nullptr;
+
+  Vector2 pos(int i) const { return {x[i], y[i]}; }
+  Vector2 dv(int i) const { return {dx[i], dy[i]}; }
+  void allocate(Arena &arena, int n);
+  void move(int dst, int src);
+};
+
+struct Rocket {
+  Vector2 pos{0, 0};
+  Vector2 dv{0, 0};
+  bool alive = false;
+};
+
+struct ExperienceColumns {
+  float *x = nullptr;
+  float *y = nullptr;
+  uint8_t *alive = nullptr;
+  int *value = nullptr;
+  int *typ = nullptr;
+
+  Vector2 pos(int i) const { return {x[i], y[i]}; }
+  void allocate(Arena &arena, int n);
+  void move(int dst, int src);
+};
+
+struct ItemColumns {
+  Vector2 *pos = nullptr;
+  int *typ = nullptr;
+  uint8_t *alive = nullptr;
+
+  void allocate(Arena &arena, int n);
+  void move(int dst, int src);
+};
+
+struct Boss {
+  Vector2 pos{0, 0};
+  int hp = 1000000;
+  bool alive = false;
+};
+
+using Enemies = Pool<EnemyColumns>;
+using Bullets = Pool<BulletColumns>;
+using Experiences = Pool<ExperienceColumns>;
+using Items = Pool<ItemColumns>;
+
+// xorshift64* generator, so that a seed fully determines a run without
+// going through raylib's global rand() state.
+struct Rng {
+  uint64_t state = 0x9E3779B97F4A7C15ull;
+
+  void seed(uint64_t s) { state = s ? s : 0x9E3779B97F4A7C15ull; }
+
+  uint64_t next() {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1Dull;
+  }
+
+  // Same contract as GetRandomValue: inclusive on both ends.
+  int value(int min, int max) {
+    if (min > max) {
+      auto tmp = min;
+      min = max;
+      max = tmp;
+    }
+    return int(next() % (uint64_t(max - min) + 1)) + min;
+  }
+};
+
+struct Input {
+  bool left = false;
+  bool right = false;
+  bool up = false;
+  bool down = false;
+
+  // One bit per key, for passing input between threads.
+  uint8_t bits() const { return left | right << 1 | up << 2 | down << 3; }
+  static Input from_bits(uint8_t bits) {
+    return Input{bool(bits & 1), bool(bits & 2), bool(bits & 4),
+                 bool(bits & 8)};
+  }
+};
+
+struct Profiler;
+
+// Sections of World::step, in the order they run.
+enum Phase {
+  PHASE_SPAWN,
+  PHASE_CONTACT,
+  PHASE_CHASE,
+  PHASE_SEPARATE,
+  PHASE_PICKUP,
+  PHASE_MERGE,
+  PHASE_COLLIDE,
+  PHASE_STEER,
+  PHASE_ROCKET,
+  PHASE_COMPACT,
+  PHASE_COUNT
+};
+
+extern const char *const PHASE_NAMES[PHASE_COUNT];
+
+// Wall time World::step spent in each phase, summed over `ticks` ticks.
+struct PhaseTimes {
+  uint64_t ns[PHASE_COUNT] = {};
+  uint64_t ticks = 0;
+};
+
+// Complete simulation state. Nothing in here touches the window, the GPU or
+// raylib's input/random functions, so it can be stepped headless. Entity
+// pools are structure-of-arrays so a pass only streams the columns it reads.
+struct World {
+  // Backs every pool column and scratch array below.
+  Arena arena;
+  Enemies enemies;
+  Bullets bullets;
+  Experiences experiences;
+  Items items;
+  Rocket rocket;
+  Boss boss;
+  int rocket_exploded = 0;
+  bool rocket_target_locked = false;
+  Handle rocket_target;
+
+  Vector2 player{720, 400};
+  int player_hp = 1000;
+  int player_speed = 2;
+  uint64_t player_experience = 0;
+  uint64_t player_level = 0;
+  int player_dir = 0;
+  int player_launches = 0;
+
+  uint64_t frame_counter = 0;
+  bool game_over = false;
+
+  int view_w = 1000;
+  int view_h = 1000;
+  Rng rng;
+  // Enemy broad-phase, rebuilt whenever the whole crowd has moved.
+  SpatialHash enemy_grid{64};
+  // On-screen enemies, the only ones homing bullets lock on to.
+  PointGrid homing_grid;
+  // Live enemies by SEPARATION_RADIUS cell, for the separation pass.
+  NeighborGrid crowd_grid;
+  // Gem kept in each MERGE_CELL cell by the current merge sweep, and the
+  // slot that sweep continues from next tick.
+  CellMap<Handle> gem_cells;
+  int merge_cursor = 0;
+  // Scratch output for the batch kernels, one entry per pool slot.
+  int *picked;
+  // Per-bullet result of the collision pass for the steering pass: the slot
+  // of the locked-on target, -1 to look for one, -2 after a direct hit.
+  int *aim;
+  // Live enemies that are not dormant, as of the chase phase.
+  uint8_t *awake;
+  // Entries each chunk of a parallel pass left in `picked` or `events`.
+  int *chunk_count;
+  // Output of the detection passes, EVENTS_PER_SLOT entries per pool slot.
+  Event *events;
+  // Live bullet slots grouped by kind for the steering pass, kind K's from
+  // kind_start[K - BULLET_STRAIGHT] on, each group in ascending order.
+  int *kind_slots;
+  int kind_start[BULLET_KINDS + 1] = {};
+  // Runs the data-parallel passes when set, otherwise they run inline.
+  // Results are the same either way.
+  JobSystem *jobs = nullptr;
+  // Accumulates per-phase timings of step() when set.
+  PhaseTimes *timing = nullptr;
+  // Records every phase of step() as a zone when set.
+  Profiler *profiler = nullptr;
+
+  // Every pool holds up to `capacity` entities.
+  explicit World(uint64_t seed, int capacity = ENOUGH);
+
+  int capacity() const { return enemies.capacity(); }
+
+  // Advances the simulation by one tick.
+  void step(const Input &input);
+  // Brings the world back to the start of a run after a game over.
+  void restart();
+  // Slot of a new enemy or bullet, or -1 when its pool is full. Bullets get
+  // the damage and lifetime of their kind.
+  int spawn_enemy(Vector2 pos, int hp);
+  int spawn_bullet(Vector2 pos, Vector2 dv, BulletKind kind);
+
+  int live_entities() const;
+  // Hash of the whole simulation state, equal for two worlds exactly when
+  // they went through the same ticks (barring collisions).
+  uint64_t checksum() const;
+
+private:
+  bool inside_the_field(Vector2 p, Vector2 q) const;
+  void drop_xp(int enemy);
+  void add_experience(int value);
+  // Folds gems into the first gem of their coarse cell, summing the values.
+  // Each tick covers the next slice of the pool, a sweep takes a few ticks.
+  void merge_gems();
+  // Damage, lifetime and target of a freshly spawned bullet of its type.
+  void arm_bullet(int b);
+  void rebuild_enemy_grid();
+  // Lowest-index live enemy whose body contains `p`, or -1.
+  int enemy_at(Vector2 p) const;
+  // Closest live enemy to `p`, or -1.
+  int nearest_enemy(Vector2 p) const;
+  void rebuild_homing_grid();
+  // Chases the player with the awake enemies and the dormant ones whose
+  // block is due, rechecks the tier of the due blocks and fills `awake`.
+  // Returns how many enemies are awake.
+  int chase_enemies(float speed);
+  // Moves every awake enemy away from the awake ones crowding it, `count`
+  // of them. Pushes are all computed from the positions before the pass, so
+  // the result doesn't depend on the order enemies are visited in.
+  void separate_enemies(float speed, int count);
+  void hit_enemy(int bullet, int enemy);
+  void hit_boss(int bullet);
+  // Kills every awake enemy within the blast radius and retires the rocket.
+  void explode(Vector2 at);
+  // Applies events[0, count) in order. An event about an entity that an
+  // earlier one has already removed is dropped.
+  void resolve(int count);
+  // Calls f(begin, end, out) over chunks of [0, n), on `jobs` if set. Each
+  // call writes at most end - begin indices to `out` and returns how many;
+  // they end up packed into `picked` in chunk order and their total is
+  // returned.
+  template <typename F> int collect(int n, int grain, F &&f);
+  // Same as collect() for passes that find events: each call writes at most
+  // EVENTS_PER_SLOT events per item to `out`, and they end up packed into
+  // `events`.
+  template <typename F> int detect(int n, int grain, F &&f);
+  // Fills kind_slots and kind_start.
+  void group_bullets();
+  // Homing, orbiting and movement of the `n` bullets of kind K in `slots`,
+  // all still alive after the collision pass. Reads enemies and writes only
+  // the bullets' own columns, and returns the bullets that left the range in
+  // `out`.
+  template <BulletKind K> int steer_kind(const int *slots, int n, int *out);
+};